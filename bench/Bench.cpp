@@ -0,0 +1,159 @@
+// The benchmark driver runs the registered benchmarks whose names begin
+// with one of the given prefixes, or all of them. Each is run several
+// times and the best time is reported, together with the number of GMP
+// allocations made by each unit of timed work and the peak resident
+// memory of the process so far. The peak only grows, so a benchmark's
+// own peak is seen by running it alone. For example:
+//
+//    sarah_bench -r 10 integer/ elaborate/nested
+//
+// Options:
+//
+//    -l        list the benchmarks and their sizes
+//    -r N      run each benchmark N times (default 5)
+//    -s X      scale the size of each benchmark by X (default 1)
+//
+// Benchmarks should be built with optimization, for example by
+// configuring with -DCMAKE_BUILD_TYPE=Release.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <sys/resource.h>
+
+#include "Bench.hpp"
+
+namespace sarah {
+
+Benchmark::Benchmark(std::string n, std::size_t k, Workload w)
+  : name(std::move(n)), size(k), run(std::move(w))
+{ benchmarks().push_back(this); }
+
+std::vector<const Benchmark*>&
+benchmarks() {
+  static std::vector<const Benchmark*> bs;
+  return bs;
+}
+
+std::string
+repeat(const std::string& s, std::size_t n, const std::string& last) {
+  std::string r;
+  r.reserve(s.size() * n + last.size());
+  for (std::size_t i = 0; i < n; ++i)
+    r += s;
+  return r + last;
+}
+
+Integer
+large() {
+  if (Integer_policy::checked)
+    return Integer(123456789);
+  return Integer(String("123456789012345678901234567890"));
+}
+
+} // namespace sarah
+
+using namespace sarah;
+
+namespace {
+
+bool
+selected(const Benchmark& b, const std::vector<const char*>& prefixes) {
+  if (prefixes.empty())
+    return true;
+  for (const char* p : prefixes)
+    if (b.name.compare(0, std::strlen(p), p) == 0)
+      return true;
+  return false;
+}
+
+// Returns the peak resident memory of the process, in kilobytes.
+long
+peak_memory() {
+  rusage r;
+  getrusage(RUSAGE_SELF, &r);
+  return r.ru_maxrss;
+}
+
+int
+usage() {
+  std::cerr << "usage: sarah_bench [-l] [-r reps] [-s scale] [prefix...]\n";
+  return 2;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv) {
+  bool list = false;
+  int reps = 5;
+  double scale = 1;
+  std::vector<const char*> prefixes;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "-l") == 0)
+      list = true;
+    else if (std::strcmp(argv[i], "-r") == 0 and i + 1 < argc)
+      reps = std::atoi(argv[++i]);
+    else if (std::strcmp(argv[i], "-s") == 0 and i + 1 < argc)
+      scale = std::atof(argv[++i]);
+    else if (argv[i][0] == '-')
+      return usage();
+    else
+      prefixes.push_back(argv[i]);
+  }
+  if (reps < 1 or scale <= 0)
+    return usage();
+
+  std::vector<const Benchmark*> bs = benchmarks();
+  std::sort(bs.begin(), bs.end(), [](const Benchmark* a, const Benchmark* b) {
+    return a->name < b->name;
+  });
+
+  // Limb arenas replace GMP's memory functions when the first one is
+  // made. Make one now, so that the counters wrap those functions.
+  { Integer_arena arena; }
+
+  std::cout << std::left << std::setw(32) << "benchmark"
+            << std::right << std::setw(10) << "n";
+  if (not list)
+    std::cout << std::setw(12) << "best ms" << std::setw(12) << "ns/n"
+              << std::setw(12) << "allocs/n" << std::setw(12) << "peak MB";
+  std::cout << '\n';
+
+  for (const Benchmark* b : bs) {
+    if (not selected(*b, prefixes))
+      continue;
+    std::size_t n = std::max<std::size_t>(1, b->size * scale);
+    std::cout << std::left << std::setw(32) << b->name
+              << std::right << std::setw(10) << n;
+    if (list) {
+      std::cout << '\n';
+      continue;
+    }
+    double best = 0;
+    std::size_t check = 0;
+    std::size_t allocs = 0;
+    std::string notes;
+    for (int r = 0; r < reps; ++r) {
+      Gmp_counter gmp;
+      Timer t(gmp);
+      check = b->run(n, t);
+      double ms = t.elapsed();
+      if (r == 0 or ms < best) {
+        best = ms;
+        notes = t.notes();
+      }
+      allocs = t.allocations();
+    }
+    std::cout << std::fixed << std::setprecision(3)
+              << std::setw(12) << best
+              << std::setw(12) << best * 1e6 / n
+              << std::setw(12) << double(allocs) / n
+              << std::setw(12) << peak_memory() / 1024.0
+              << "  (" << check << ")" << notes << '\n';
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef SARAH_BENCH_HPP
+#define SARAH_BENCH_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "utility/Integer.hpp"
+
+#include "Program.hpp"
+#include "Gmp_counter.hpp"
+
+namespace sarah {
+
+// A Timer measures the work of one run of a benchmark, in time and in
+// GMP allocations. It starts when the run does; a benchmark that
+// prepares its input first restarts it with reset() once the input is
+// ready, and one that tears down large structures afterwards stops it
+// with stop() first.
+class Timer {
+public:
+  using clock = std::chrono::steady_clock;
+
+  explicit Timer(const Gmp_counter& c)
+    : gmp(c), start(clock::now()), first(c.allocations()), stopped(-1),
+      last(0)
+  { }
+
+  void reset() {
+    start = clock::now();
+    first = gmp.allocations();
+  }
+
+  void stop() {
+    stopped = elapsed();
+    last = gmp.allocations();
+  }
+
+  // Returns the time since the timer was started, or until it was
+  // stopped, in milliseconds.
+  double elapsed() const {
+    if (stopped >= 0)
+      return stopped;
+    return std::chrono::duration<double, std::milli>(clock::now() - start)
+      .count();
+  }
+
+  // Returns the number of GMP allocations made in the same interval.
+  std::size_t allocations() const {
+    return (stopped >= 0 ? last : gmp.allocations()) - first;
+  }
+
+  // Records a figure that is printed with the result of the run, such as
+  // "24 bytes/node".
+  void note(const std::string& s) { figures += "  " + s; }
+
+  const std::string& notes() const { return figures; }
+
+private:
+  const Gmp_counter& gmp;
+  clock::time_point start;
+  std::size_t first;
+  double stopped;
+  std::size_t last;
+  std::string figures;
+};
+
+// A workload does n units of work and returns a value computed from its
+// results, which is printed so that the work cannot be optimized away.
+using Workload = std::function<std::size_t(std::size_t n, Timer& t)>;
+
+// A Benchmark is a named workload together with its default size. Each
+// benchmark is registered when it is constructed, so defining one at
+// namespace scope adds it to the driver. Names are grouped by a prefix,
+// as in "integer/add".
+struct Benchmark {
+  Benchmark(std::string name, std::size_t n, Workload w);
+
+  std::string name;
+  std::size_t size;
+  Workload run;
+};
+
+// Returns the registered benchmarks, in no particular order.
+std::vector<const Benchmark*>& benchmarks();
+
+// Returns the text repeated n times, followed by the last text.
+std::string repeat(const std::string& s, std::size_t n,
+                   const std::string& last = "");
+
+// Returns an integer larger than a word. The checked backends cannot
+// represent one, so a small value is returned instead.
+Integer large();
+
+} // namespace sarah
+
+#endif
@@ -0,0 +1,279 @@
+// Benchmarks of integer arithmetic, gcds and formatting.
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "utility/Integer.hpp"
+#include "utility/Gcd.hpp"
+#include "utility/Ios.hpp"
+
+#include "Bench.hpp"
+
+using namespace sarah;
+
+namespace {
+
+// -------------------------------------------------------------------------- //
+// Small values
+//
+// Each operator is applied to n pairs of values that fit in a word. An
+// iteration copies the left operand, applies the operator to the copy
+// and stores the result, as code that computes a new value does. The
+// same loops over raw mpz_t values, named with an -mpz suffix, are the
+// baseline of an Integer that is always a GMP integer. Building with
+// -DSARAH_INTEGER_BACKEND=gmp runs the Integer loops on that
+// representation.
+
+constexpr std::size_t operands = 64;
+
+// Returns the left operand i.
+long
+left(std::size_t i) { return long(i * 7919 % 500000) - 250000; }
+
+// Returns the right operand i, which is not 0.
+long
+right(std::size_t i) { return long(i % 31 + 1) * (i % 2 ? 1 : -1); }
+
+// Applies op to n pairs of operands.
+template<typename Op>
+  std::size_t
+  apply(std::size_t n, Timer& t, Op op) {
+    std::vector<Integer> xs, ys, rs(operands);
+    for (std::size_t i = 0; i < operands; ++i) {
+      xs.emplace_back(left(i));
+      ys.emplace_back(right(i));
+    }
+    t.reset();
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t j = i % operands;
+      Integer r = xs[j];
+      op(r, ys[i / operands % operands]);
+      rs[j] = std::move(r);
+    }
+    t.stop();
+    std::size_t k = 0;
+    for (const Integer& r : rs)
+      k += hash(r);
+    return k;
+  }
+
+// Applies op to n pairs of mpz_t operands.
+template<typename Op>
+  std::size_t
+  apply_mpz(std::size_t n, Timer& t, Op op) {
+    mpz_t xs[operands], ys[operands], rs[operands];
+    for (std::size_t i = 0; i < operands; ++i) {
+      mpz_init_set_si(xs[i], left(i));
+      mpz_init_set_si(ys[i], right(i));
+      mpz_init(rs[i]);
+    }
+    t.reset();
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t j = i % operands;
+      mpz_t r;
+      mpz_init_set(r, xs[j]);
+      op(r, ys[i / operands % operands]);
+      mpz_swap(rs[j], r);
+      mpz_clear(r);
+    }
+    t.stop();
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < operands; ++i) {
+      k += mpz_get_si(rs[i]);
+      mpz_clears(xs[i], ys[i], rs[i], nullptr);
+    }
+    return k;
+  }
+
+Benchmark add_small("integer/add", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply(n, t, [](Integer& r, const Integer& y) { r += y; });
+  });
+
+Benchmark add_small_mpz("integer/add-mpz", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply_mpz(n, t, [](mpz_t r, const mpz_t y) { mpz_add(r, r, y); });
+  });
+
+Benchmark mul_small("integer/mul", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply(n, t, [](Integer& r, const Integer& y) { r *= y; });
+  });
+
+Benchmark mul_small_mpz("integer/mul-mpz", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply_mpz(n, t, [](mpz_t r, const mpz_t y) { mpz_mul(r, r, y); });
+  });
+
+Benchmark div_small("integer/div", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply(n, t, [](Integer& r, const Integer& y) { r /= y; });
+  });
+
+Benchmark div_small_mpz("integer/div-mpz", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply_mpz(n, t, [](mpz_t r, const mpz_t y) {
+      mpz_tdiv_q(r, r, y);
+    });
+  });
+
+Benchmark mod_small("integer/mod", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply(n, t, [](Integer& r, const Integer& y) { r %= y; });
+  });
+
+Benchmark mod_small_mpz("integer/mod-mpz", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return apply_mpz(n, t, [](mpz_t r, const mpz_t y) {
+      mpz_tdiv_r(r, r, y);
+    });
+  });
+
+// Comparisons do not make values, so the operands are compared in place.
+Benchmark compare_small("integer/compare", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    std::vector<Integer> xs, ys;
+    for (std::size_t i = 0; i < operands; ++i) {
+      xs.emplace_back(left(i));
+      ys.emplace_back(left(i + 1));
+    }
+    t.reset();
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      const Integer& y = ys[i / operands % operands];
+      k += xs[i % operands] < y;
+    }
+    t.stop();
+    return k;
+  });
+
+Benchmark compare_small_mpz("integer/compare-mpz", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    mpz_t xs[operands], ys[operands];
+    for (std::size_t i = 0; i < operands; ++i) {
+      mpz_init_set_si(xs[i], left(i));
+      mpz_init_set_si(ys[i], left(i + 1));
+    }
+    t.reset();
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i)
+      k += mpz_cmp(xs[i % operands], ys[i / operands % operands]) < 0;
+    t.stop();
+    for (std::size_t i = 0; i < operands; ++i)
+      mpz_clears(xs[i], ys[i], nullptr);
+    return k;
+  });
+
+// -------------------------------------------------------------------------- //
+// Large values
+
+// Arithmetic whose intermediate results overflow a word, so values are
+// promoted to GMP and narrowed again. The checked backends cannot
+// represent the intermediate results, so there is nothing to measure.
+Benchmark promote("integer/promote", 100000,
+  [](std::size_t n, Timer&) -> std::size_t {
+    if (Integer_policy::checked)
+      return 0;
+    Integer big(String("100000000000000000000000"));
+    Integer a(7);
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      Integer b = a * big + Integer(long(i));
+      b /= big;
+      k += b.is_small();
+    }
+    return k;
+  });
+
+// -------------------------------------------------------------------------- //
+// Coefficient arrays
+//
+// The batch kernels run on n rows of w coefficients, as in linear terms
+// with w variables. Small rows share a factor and have a small lcm, so
+// the kernels stay on machine words. Large rows are multiples of a value
+// larger than a word, which forces the GMP fallback; the checked backends
+// cannot represent them, so only small rows are measured there.
+
+// A batch kernel and its name.
+struct Kernel {
+  const char* name;
+  Integer (*run)(Integer*, std::size_t);
+};
+
+const Kernel kernels[] = {
+  {"gcd", [](Integer* a, std::size_t n) { return gcd(a, n); }},
+  {"lcm", [](Integer* a, std::size_t n) { return lcm(a, n); }},
+  {"content", [](Integer* a, std::size_t n) {
+    return divide_content(a, n);
+  }},
+};
+
+// Applies f to n rows of w coefficients.
+std::size_t
+run_rows(const Kernel& f, std::size_t w, bool big, std::size_t n, Timer& t) {
+  Integer factor = big ? large() : Integer(6);
+  std::vector<Integer> a;
+  a.reserve(n * w);
+  for (std::size_t i = 0; i < n * w; ++i)
+    a.push_back(factor * Integer(long(i % 16 + 1)));
+  t.reset();
+  std::size_t k = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    k += hash(f.run(&a[i * w], w));
+  t.stop();
+  return k;
+}
+
+// Registers a benchmark for each kernel, row width and kind of row, as in
+// "coeffs/lcm-016-large". Each processes about 2^20 coefficients.
+struct Kernel_benchmarks {
+  Kernel_benchmarks() {
+    for (const Kernel& f : kernels)
+      for (std::size_t w : {4, 16, 64, 256})
+        for (bool big : {false, true}) {
+          if (big and Integer_policy::checked)
+            continue;
+          std::string width = std::to_string(w);
+          width.insert(0, 3 - width.size(), '0');
+          std::string name = std::string("coeffs/") + f.name + "-" + width;
+          if (big)
+            name += "-large";
+          bs.emplace_back(new Benchmark(name, (1 << 20) / w,
+            [&f, w, big](std::size_t n, Timer& t) {
+              return run_rows(f, w, big, n, t);
+            }));
+        }
+  }
+
+  std::vector<std::unique_ptr<Benchmark>> bs;
+};
+
+Kernel_benchmarks kernel_benchmarks;
+
+// Formatting small and large values into an output buffer.
+Benchmark write_ints("integer/write", 1000000,
+  [](std::size_t n, Timer&) -> std::size_t {
+    Integer big = large();
+    Output_buffer buf;
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      write(buf, i % 16 ? Integer(long(i)) : big);
+      k += buf.size();
+      buf.clear();
+    }
+    return k;
+  });
+
+// Streaming small and large values.
+Benchmark stream_ints("integer/stream", 1000000,
+  [](std::size_t n, Timer&) -> std::size_t {
+    Integer big = large();
+    std::ostringstream ss;
+    for (std::size_t i = 0; i < n; ++i)
+      ss << (i % 16 ? Integer(long(i)) : big) << ' ';
+    return ss.str().size();
+  });
+
+} // namespace
@@ -0,0 +1,750 @@
+// Benchmarks of expression construction, comparison, elaboration and
+// environments.
+
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "semantics/Debug.hpp"
+#include "semantics/Elaborator.hpp"
+#include "semantics/Normalize.hpp"
+#include "semantics/Pool.hpp"
+#include "utility/Ios.hpp"
+
+#include "Bench.hpp"
+
+using namespace sarah;
+
+namespace {
+
+// Returns the number of expressions made by f.
+std::size_t
+made(const Expr::Factory& f) {
+  std::size_t k = 0;
+  for (const Factory_mark& m : f.mark().marks)
+    k += m.count;
+  return k;
+}
+
+// Returns n nested quantifiers whose body refers to every variable.
+std::string
+nested_foralls(std::size_t n) {
+  std::string s;
+  for (std::size_t i = 0; i < n; ++i)
+    s += "forall x" + std::to_string(i) + ":int. ";
+  s += "x0 == x" + std::to_string(n - 1);
+  for (std::size_t i = 0; i < n; ++i)
+    s += " and x" + std::to_string(i) + " >= 0";
+  return s;
+}
+
+// Returns a formula with n distinct linear constraints.
+std::string
+constraints(std::size_t n) {
+  std::string s = "forall x:int. forall y:int. forall z:int. true";
+  for (std::size_t i = 0; i < n; ++i) {
+    std::string k = std::to_string(i % 17 + 1);
+    s += " and " + k + " * x + 2 * (y - " + k + " * z) + x < "
+       + std::to_string(i);
+  }
+  return s;
+}
+
+// -------------------------------------------------------------------------- //
+// Construction
+
+// Notes the rate at which f made its nodes while t ran, and the bytes of
+// slab reserved for each. The timer must be stopped.
+void
+note_nodes(const Expr::Factory& f, Timer& t) {
+  std::size_t k = made(f);
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1)
+     << k / t.elapsed() / 1000 << " Mnodes/s  "
+     << double(f.capacity()) / k << " bytes/node";
+  t.note(ss.str());
+}
+
+// Making nodes in the factory's slabs.
+Benchmark factory_make("factory/make", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Context cxt;
+    const Expr* e = &cxt.make_int(0);
+    for (std::size_t i = 0; i < n; ++i)
+      e = &cxt.make_add(*e, cxt.make_int(long(i % 64)));
+    t.stop();
+    note_nodes(cxt, t);
+    return made(cxt);
+  });
+
+// Making the nodes of a formula with n constraints by elaborating it.
+Benchmark factory_elab("factory/elaborate", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(constraints(n));
+    t.reset();
+    Elaborator elab;
+    elab(*p.tree);
+    t.stop();
+    note_nodes(elab, t);
+    return made(elab);
+  });
+
+// -------------------------------------------------------------------------- //
+// Comparison
+
+// Comparing two copies of a formula made by separate elaborations.
+Benchmark same_copies("same/copies", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(constraints(n));
+    Elaborator elab;
+    Elaboration a = elab(*p.tree);
+    Elaboration b = elab(*p.tree);
+    t.reset();
+    std::size_t k = same(a.expr(), b.expr());
+    t.stop();
+    return k;
+  });
+
+// Comparing two elaborations of a deep formula. Each node has a single
+// operand below it, so the comparison walks a chain n nodes long.
+std::size_t
+same_chain(const std::string& text, Timer& t) {
+  Program p(text);
+  Elaborator elab;
+  Elaboration a = elab(*p.tree);
+  Elaboration b = elab(*p.tree);
+  t.reset();
+  std::size_t k = same(a.expr(), b.expr());
+  t.stop();
+  return k;
+}
+
+Benchmark same_not("same/not-chain", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return same_chain(repeat("not ", n, "1 == 0"), t);
+  });
+
+Benchmark same_foralls("same/forall-chain", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return same_chain(repeat("forall x:int. ", n, "x > 0"), t);
+  });
+
+// Comparing elaborations with the pool's equality.
+Benchmark pool_same("pool/same", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(constraints(n));
+    Elaborator elab;
+    Expr_pool pool;
+    Expr_id a = pool.import(elab(*p.tree).expr());
+    Expr_id b = pool.import(elab(*p.tree).expr());
+    t.reset();
+    std::size_t k = same(pool, a, b);
+    t.stop();
+    return k;
+  });
+
+// Copying a formula into a pool and back out.
+Benchmark pool_round_trip("pool/round-trip", 20000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(constraints(n));
+    Elaborator elab;
+    const Expr& e = elab(*p.tree).expr();
+    Context out;
+    t.reset();
+    Expr_pool pool;
+    out.make_bool(same(e, pool.export_expr(out, pool.import(e))));
+    t.stop();
+    return pool.size();
+  });
+
+// -------------------------------------------------------------------------- //
+// Dispatch
+
+// Counts of the atoms, operators and quantifiers in an expression.
+struct Node_counts {
+  std::size_t atoms = 0;
+  std::size_t ops = 0;
+  std::size_t quants = 0;
+
+  std::size_t total() const { return atoms + ops + quants; }
+};
+
+// Counts nodes through the virtual Visitor. Operators are counted by the
+// fallback, as a pass would handle the classes it does not care about.
+struct Count_visitor : Expr::Visitor {
+  void visit_expr(const Expr&) override { ++counts.ops; }
+  void visit(const Id&) override { ++counts.atoms; }
+  void visit(const Bool&) override { ++counts.atoms; }
+  void visit(const Int&) override { ++counts.atoms; }
+  void visit(const Var&) override { ++counts.atoms; }
+  void visit(const Exists&) override { ++counts.quants; }
+  void visit(const Forall&) override { ++counts.quants; }
+  void visit_type(const Type&) override { ++counts.atoms; }
+
+  Node_counts counts;
+};
+
+// Counts nodes through visit(), with the same fallback.
+struct Count_fn {
+  void operator()(const Expr&) { ++counts.ops; }
+  void operator()(const Id&) { ++counts.atoms; }
+  void operator()(const Bool&) { ++counts.atoms; }
+  void operator()(const Int&) { ++counts.atoms; }
+  void operator()(const Var&) { ++counts.atoms; }
+  void operator()(const Exists&) { ++counts.quants; }
+  void operator()(const Forall&) { ++counts.quants; }
+  void operator()(const Type&) { ++counts.atoms; }
+
+  Node_counts counts;
+};
+
+// Calls dispatch on every node of e, walking it with an explicit stack.
+template<typename F>
+  void
+  each_node(const Expr& e, std::vector<const Expr*>& stack, F dispatch) {
+    stack.push_back(&e);
+    while (not stack.empty()) {
+      const Expr& x = *stack.back();
+      stack.pop_back();
+      dispatch(x);
+      for (std::size_t i = 0; i < arity(x); ++i)
+        stack.push_back(&operand(x, i));
+    }
+  }
+
+// Counts the nodes of a formula with n constraints, 10 times, using the
+// dispatch of count. Only the passes are timed.
+template<typename Count>
+  std::size_t
+  count_nodes(std::size_t n, Timer& t, Count count) {
+    Program p(constraints(n));
+    Elaborator elab;
+    const Expr& e = elab(*p.tree).expr();
+    std::vector<const Expr*> stack;
+    t.reset();
+    std::size_t k = 0;
+    for (int i = 0; i < 10; ++i)
+      k += count(e, stack).total();
+    t.stop();
+    return k;
+  }
+
+Benchmark dispatch_visitor("dispatch/visitor", 20000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return count_nodes(n, t, [](const Expr& e, std::vector<const Expr*>& s) {
+      Count_visitor v;
+      each_node(e, s, [&v](const Expr& x) { x.accept(v); });
+      return v.counts;
+    });
+  });
+
+Benchmark dispatch_visit("dispatch/visit", 20000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return count_nodes(n, t, [](const Expr& e, std::vector<const Expr*>& s) {
+      Count_fn f;
+      each_node(e, s, [&f](const Expr& x) { visit(x, f); });
+      return f.counts;
+    });
+  });
+
+// -------------------------------------------------------------------------- //
+// Hashing
+
+// Sets of expressions that are distinct by structure.
+struct Structure_hash {
+  std::size_t operator()(const Expr* e) const { return hash(*e); }
+};
+
+struct Structure_eq {
+  bool operator()(const Expr* a, const Expr* b) const { return same(*a, *b); }
+};
+
+using Structure_set =
+  std::unordered_set<const Expr*, Structure_hash, Structure_eq>;
+
+// Making n constraints a * x + b * y < c over a range of coefficients,
+// which hashes each node as it is made. The distinct structures among
+// the nodes, the distinct hashes among those structures, and the rate of
+// hashing are noted.
+Benchmark hash_make("hash/make", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Context cxt;
+    const Id& x = cxt.make_id("x");
+    const Id& y = cxt.make_id("y");
+    std::vector<const Expr*> es;
+    es.reserve(n);
+    std::size_t k = made(cxt);
+    t.reset();
+    for (std::size_t i = 0; i < n; ++i) {
+      const Int& a = cxt.make_int(long(i % 61));
+      const Int& b = cxt.make_int(long(i / 61 % 59));
+      const Int& c = cxt.make_int(long(i / (61 * 59)));
+      const Expr& l = cxt.make_add(cxt.make_mul(a, x), cxt.make_mul(b, y));
+      es.push_back(&cxt.make_lt(l, c));
+    }
+    t.stop();
+    k = made(cxt) - k;
+
+    Structure_set structures;
+    std::unordered_set<std::size_t> hashes;
+    std::vector<const Expr*> stack;
+    for (const Expr* e : es)
+      each_node(*e, stack, [&](const Expr& x) {
+        if (structures.insert(&x).second)
+          hashes.insert(hash(x));
+      });
+    std::ostringstream ss;
+    ss << structures.size() << " structures  " << hashes.size()
+       << " hashes  " << std::fixed << std::setprecision(1)
+       << k / t.elapsed() / 1000 << " Mhashes/s";
+    t.note(ss.str());
+    return structures.size();
+  });
+
+// -------------------------------------------------------------------------- //
+// Elaboration
+
+// Returns the number of nodes of e, counting shared nodes once for each
+// path to them, and its depth.
+std::pair<std::size_t, std::size_t>
+shape(const Expr& e) {
+  std::size_t nodes = 0;
+  std::size_t depth = 0;
+  std::vector<std::pair<const Expr*, std::size_t>> stack {{&e, 1}};
+  while (not stack.empty()) {
+    const Expr& x = *stack.back().first;
+    std::size_t d = stack.back().second;
+    stack.pop_back();
+    ++nodes;
+    depth = std::max(depth, d);
+    for (std::size_t i = 0; i < arity(x); ++i)
+      stack.emplace_back(&operand(x, i), d + 1);
+  }
+  return {nodes, depth};
+}
+
+// Elaborating a long conjunction of distinct atoms into one n-ary node.
+// Its nodes and depth are noted beside those of the binary spine of the
+// same atoms, which has one conjunction for each atom but the last.
+Benchmark elab_and("elaborate/and-chain", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    std::string s;
+    for (std::size_t i = 0; i < n; ++i)
+      s += std::to_string(i) + " == 0 and ";
+    Program p(s + std::to_string(n) + " == 0");
+    t.reset();
+    Elaborator elab;
+    const Expr& e = elab(*p.tree).expr();
+    t.stop();
+
+    std::size_t ops = is<And>(e) ? as<Nary>(e).operands().size() : 1;
+    std::pair<std::size_t, std::size_t> nary = shape(e);
+    std::size_t spine = ops - 1;
+    std::ostringstream ss;
+    ss << nary.first << " nodes, depth " << nary.second << "  (binary: "
+       << nary.first - 1 + spine << " nodes, depth "
+       << nary.second - 1 + spine << ")";
+    t.note(ss.str());
+    return made(elab);
+  });
+
+// Elaborating a deep chain of negations.
+Benchmark elab_not("elaborate/not-chain", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(repeat("not ", n, "1 == 0"));
+    t.reset();
+    Elaborator elab;
+    elab(*p.tree);
+    t.stop();
+    return made(elab);
+  });
+
+// Returns a formula with n comparisons against distinct literals, which
+// are large unless the backend is checked.
+std::string
+literals(std::size_t n) {
+  std::string big = "1234";
+  if (not Integer_policy::checked)
+    big += "567890123456789012";
+  std::string s = "forall x:int. true";
+  for (std::size_t i = 0; i < n; ++i)
+    s += " and x < " + big + std::to_string(i);
+  return s;
+}
+
+// Elaborating a formula full of literals, with and without a limb arena.
+// The elaborator is destroyed before the timer stops, since an arena
+// releases the limbs of all its literals at once. Run each of these alone
+// to compare their peak memory.
+std::size_t
+elab_literals(bool arena, std::size_t n, Timer& t) {
+  Program p(literals(n));
+  t.reset();
+  std::size_t k;
+  {
+    Elaborator elab(arena);
+    elab(*p.tree);
+    k = made(elab);
+  }
+  t.stop();
+  return k;
+}
+
+Benchmark elab_ints("elaborate/literals-malloc", 200000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return elab_literals(false, n, t);
+  });
+
+Benchmark elab_ints_arena("elaborate/literals-arena", 200000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return elab_literals(true, n, t);
+  });
+
+// Elaborating nested quantifiers whose body refers to every variable,
+// which exercises name lookup through deep scopes.
+Benchmark elab_nested("elaborate/nested-foralls", 3000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(nested_foralls(n));
+    t.reset();
+    Elaborator elab;
+    elab(*p.tree);
+    t.stop();
+    return made(elab);
+  });
+
+// Elaborating a formula with 20 constraints n times, each in a factory
+// scope that discards its expressions. Each batch reuses the slabs of the
+// last, so the slab bytes after n batches are those after the first, and
+// the peak memory does not grow with n. Run this alone to see its peak.
+Benchmark elab_batches("elaborate/scoped-batches", 10000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(constraints(20));
+    Elaborator elab;
+    const Expr::Factory& f = elab;
+    std::size_t first = 0;
+    std::size_t k = 0;
+    t.reset();
+    for (std::size_t i = 0; i < n; ++i) {
+      Factory_scope scope(elab);
+      k += bool(elab(*p.tree));
+      if (i == 0)
+        first = f.capacity();
+    }
+    t.stop();
+    std::ostringstream ss;
+    ss << "slab bytes: " << first << " after 1, " << f.capacity()
+       << " after " << n;
+    t.note(ss.str());
+    return k;
+  });
+
+// Returns a formula with n linear constraints that are multiples of 50
+// distinct constraints, written in two arrangements.
+std::string
+equivalent_constraints(std::size_t n) {
+  std::string s = "forall x:int. forall y:int. true";
+  for (std::size_t i = 0; i < n; ++i) {
+    std::size_t k = i % 7 + 1;
+    std::string a = std::to_string(k) + " * x";
+    std::string b = std::to_string(2 * k) + " * y";
+    std::string c = std::to_string(k * (i % 50));
+    if (i % 2)
+      s += " and " + a + " - " + c + " + " + b + " < 0";
+    else
+      s += " and " + b + " + " + a + " < " + c;
+  }
+  return s;
+}
+
+// Returns the number of distinct atoms in e.
+std::size_t
+distinct_atoms(const Expr& e) {
+  Structure_set atoms;
+  std::vector<const Expr*> stack;
+  each_node(e, stack, [&atoms](const Expr& x) {
+    switch (x.tag) {
+    case Div_kind:
+    case Eq_kind: case Ne_kind: case Lt_kind:
+    case Gt_kind: case Le_kind: case Ge_kind:
+      atoms.insert(&x);
+      break;
+    default:
+      break;
+    }
+  });
+  return atoms.size();
+}
+
+// Normalizing the linear constraints of a formula. The distinct atoms and
+// the nodes of the formula are noted before and after.
+std::size_t
+normalize_atoms(const std::string& text, Timer& t) {
+  Program p(text);
+  Elaborator elab;
+  const Expr& e = elab(*p.tree).expr();
+  t.reset();
+  const Expr& r = normalize(elab, e);
+  t.stop();
+  std::ostringstream ss;
+  ss << distinct_atoms(e) << " -> " << distinct_atoms(r) << " atoms  "
+     << shape(e).first << " -> " << shape(r).first << " nodes";
+  t.note(ss.str());
+  return hash(r);
+}
+
+Benchmark normalize_linear("normalize/linear", 20000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return normalize_atoms(constraints(n), t);
+  });
+
+Benchmark normalize_equivalent("normalize/equivalent", 20000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return normalize_atoms(equivalent_constraints(n), t);
+  });
+
+// -------------------------------------------------------------------------- //
+// Printing
+
+// Printing a formula with n distinct constraints, elaborated with hash-
+// consing so that its atoms share their variables and literals, into an
+// output buffer.
+Benchmark print_buffer("print/buffer", 20000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(constraints(n));
+    Elaborator elab(false, true);
+    const Expr& e = elab(*p.tree).expr();
+    Output_buffer buf;
+    t.reset();
+    print_expr(buf, e);
+    t.stop();
+    return buf.size();
+  });
+
+// Printing the same formula as print/buffer to a string stream with
+// operator<<, for comparison. This renders into a buffer of its own and
+// writes it to the stream once.
+Benchmark print_stream("print/stream", 20000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Program p(constraints(n));
+    Elaborator elab(false, true);
+    const Expr& e = elab(*p.tree).expr();
+    std::ostringstream ss;
+    t.reset();
+    ss << e;
+    t.stop();
+    return ss.str().size();
+  });
+
+// -------------------------------------------------------------------------- //
+// Rules
+
+// Returns the distinct nodes of the elaborations, by address and by the
+// text they print as. Bound variables are printed with their names, so
+// the text tells alpha-equivalent nodes apart.
+std::pair<std::size_t, std::size_t>
+distinct_nodes(const std::vector<Elaboration>& es) {
+  std::unordered_set<const Expr*> nodes;
+  std::unordered_set<std::string> texts;
+  std::vector<const Expr*> stack;
+  for (const Elaboration& e : es) {
+    stack.push_back(&e.expr());
+    while (not stack.empty()) {
+      const Expr& x = *stack.back();
+      stack.pop_back();
+      if (not nodes.insert(&x).second)
+        continue;
+      std::ostringstream ss;
+      ss << x;
+      texts.insert(ss.str());
+      for (std::size_t i = 0; i < arity(x); ++i)
+        stack.push_back(&operand(x, i));
+    }
+  }
+  return {nodes.size(), texts.size()};
+}
+
+// Notes the nodes of the formulas in a factory that conses them by
+// structure, with bound variables as de Bruijn indices, beside the nodes
+// of the same formulas in a plain factory and the nodes that consing
+// them by name would leave.
+void
+note_sharing(const std::vector<std::unique_ptr<Program>>& ps,
+             const Elaborator& consed, Timer& t) {
+  Elaborator plain;
+  for (const auto& p : ps)
+    plain.elaborate(*p->tree);
+  std::pair<std::size_t, std::size_t> named =
+    distinct_nodes(plain.elaborations);
+  std::size_t indexed = distinct_nodes(consed.elaborations).first;
+  std::ostringstream ss;
+  ss << indexed << " nodes consed  (" << named.second << " by name, "
+     << named.first << " unshared)";
+  t.note(ss.str());
+}
+
+// Mirrors RuleSystem::expand in the driver on n families of a fact and
+// a rule whose antecedent restates it, each written 5 times with
+// different names. A rule fires when some formula is the same as its
+// antecedent. Only the expansion is timed. With consing, the nodes of
+// the alpha-equivalent formulas are noted.
+std::size_t
+expand(bool consing, std::size_t n, Timer& t) {
+  std::vector<std::unique_ptr<Program>> ps;
+  for (std::size_t r = 0; r < 5; ++r) {
+    std::string s = std::to_string(r);
+    for (std::size_t i = 0; i < n; ++i) {
+      std::string a = std::to_string(i);
+      std::string k = std::to_string(i + 2);
+      ps.emplace_back(new Program("forall a" + s + ":int. exists b" + s
+        + ":int. " + k + " * a" + s + " + b" + s + " > " + a));
+      ps.emplace_back(new Program("(forall c" + s + ":int. exists d" + s
+        + ":int. " + k + " * c" + s + " + d" + s + " > " + a + ") -> "
+        + "(forall e" + s + ":int. e" + s + " + " + a + " >= e" + s + ")"));
+    }
+  }
+  Elaborator elab(false, consing);
+  for (const auto& p : ps)
+    elab.elaborate(*p->tree);
+  if (consing)
+    note_sharing(ps, elab, t);
+  t.reset();
+  std::vector<Elaboration>& es = elab.elaborations;
+  std::size_t derived = 0;
+  std::size_t size = es.size();
+  for (std::size_t i = 0; i < size; ++i) {
+    const Imp* imp = as<Imp>(&es[i].expr());
+    if (not imp)
+      continue;
+    for (std::size_t j = 0; j < size; ++j)
+      if (same(es[j].expr(), imp->left())) {
+        es.push_back(Elaboration(imp->right(), es[i].type()));
+        ++derived;
+        break;
+      }
+  }
+  t.stop();
+  return made(elab) + derived;
+}
+
+Benchmark rules_plain("rules/expand", 200,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return expand(false, n, t);
+  });
+
+Benchmark rules_consed("rules/expand-consed", 200,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return expand(true, n, t);
+  });
+
+// -------------------------------------------------------------------------- //
+// Environments
+
+// A stack of n scopes, each declaring one name.
+struct Scopes {
+  explicit Scopes(std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      names.push_back(&cxt.make_id("x" + std::to_string(i)));
+      envs.emplace_back(new Environment());
+      cxt.push(*envs.back());
+      decls.push_back(&cxt.declare(*names.back(), cxt.int_type));
+    }
+  }
+
+  ~Scopes() {
+    for (std::size_t i = 0; i < envs.size(); ++i)
+      cxt.pop();
+  }
+
+  Context cxt;
+  std::vector<const Id*> names;
+  std::vector<const Decl*> decls;
+  std::vector<std::unique_ptr<Environment>> envs;
+};
+
+// A copy of the stack of some scopes, including the context's own scope,
+// made by binding their declarations again in new environments. This is
+// what a branch that cannot share a stack must do.
+struct Stack_copy {
+  explicit Stack_copy(const Scopes& s)
+    : envs(new Environment[s.decls.size() + 1]) {
+    stack.push(envs[0]);
+    stack.bind(*s.cxt.bool_def);
+    stack.bind(*s.cxt.int_def);
+    for (std::size_t i = 0; i < s.decls.size(); ++i) {
+      stack.push(envs[i + 1]);
+      stack.bind(*s.decls[i]);
+    }
+  }
+
+  ~Stack_copy() {
+    while (not stack.empty())
+      stack.pop();
+  }
+
+  std::unique_ptr<Environment[]> envs;
+  Stack stack;
+};
+
+// Taking a snapshot of a stack of n scopes and binding one more name in
+// it. The stack keeps its snapshot up to date, so this takes constant
+// time whatever n is.
+Benchmark env_snapshot("environment/snapshot", 10000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Scopes s(n);
+    Decl extra(s.cxt.make_id("branch"), s.cxt.int_type);
+    t.reset();
+    Persistent_environment e = s.cxt.snapshot().bind(extra);
+    t.stop();
+    return e.size();
+  });
+
+// Copying a stack of n scopes, for comparison with a snapshot. This takes
+// time in proportion to n.
+Benchmark env_copy("environment/copy-stack", 10000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Scopes s(n);
+    t.reset();
+    Stack_copy c(s);
+    t.stop();
+    return c.stack.size();
+  });
+
+// Forking n branches from a snapshot of 1000 scopes, each binding one
+// more name and looking one up.
+Benchmark env_fork("environment/fork", 1000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Scopes s(1000);
+    Persistent_environment snap = s.cxt.snapshot();
+    Decl extra(s.cxt.make_id("branch"), s.cxt.int_type);
+    t.reset();
+    std::size_t k = 0;
+    for (std::size_t b = 0; b < n; ++b) {
+      Persistent_environment mine = snap.bind(extra);
+      k += mine.lookup(s.names[b % 1000]->str()) != nullptr;
+    }
+    t.stop();
+    return k;
+  });
+
+// Forking n branches as in environment/fork, but by copying the stack
+// of 1000 scopes for each branch.
+Benchmark env_copy_fork("environment/copy-fork", 1000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Scopes s(1000);
+    Decl extra(s.cxt.make_id("branch"), s.cxt.int_type);
+    t.reset();
+    std::size_t k = 0;
+    for (std::size_t b = 0; b < n; ++b) {
+      Stack_copy mine(s);
+      mine.stack.bind(extra);
+      k += mine.stack.lookup(s.names[b % 1000]->str()) != nullptr;
+    }
+    t.stop();
+    return k;
+  });
+
+} // namespace
@@ -0,0 +1,286 @@
+// Benchmarks of interning, lexing and reading files.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utility/File.hpp"
+#include "utility/String.hpp"
+
+#include "Bench.hpp"
+
+using namespace sarah;
+
+namespace {
+
+// Returns n names, of which there are 1000 distinct spellings.
+std::vector<std::string>
+names(std::size_t n) {
+  std::vector<std::string> r;
+  r.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    r.push_back("name" + std::to_string(i % 1000));
+  return r;
+}
+
+// Interning names that are already in the table.
+Benchmark intern("string/intern", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    std::vector<std::string> ns = names(n);
+    t.reset();
+    std::size_t k = 0;
+    for (const std::string& s : ns)
+      k += String(s.data(), s.size()).id();
+    t.stop();
+    return k;
+  });
+
+// Interning the same names on k threads at once. Each thread interns all
+// n names, so with perfect scaling the time does not depend on k.
+std::size_t
+intern_on(std::size_t k, std::size_t n, Timer& t) {
+  std::vector<std::string> ns = names(n);
+  std::vector<std::size_t> ks(k);
+  t.reset();
+  std::vector<std::thread> ts;
+  for (std::size_t i = 0; i < k; ++i)
+    ts.emplace_back([&ns, &ks, i]() {
+      for (const std::string& s : ns)
+        ks[i] += String(s.data(), s.size()).id();
+    });
+  for (std::thread& th : ts)
+    th.join();
+  t.stop();
+  return ks[0];
+}
+
+// One benchmark is registered for each power of two below the number of
+// hardware threads, and one for that number, taken to be at least 4, so
+// that the scaling of the sharded table is visible. Names are padded so
+// that they sort by count.
+struct Intern_threads {
+  Intern_threads() {
+    std::size_t most = std::max(4u, std::thread::hardware_concurrency());
+    std::vector<std::size_t> counts;
+    for (std::size_t k = 1; k < most; k *= 2)
+      counts.push_back(k);
+    counts.push_back(most);
+    for (std::size_t k : counts) {
+      std::string pad = k < 10 ? "0" : "";
+      bs.emplace_back(new Benchmark(
+        "string/intern-threads-" + pad + std::to_string(k), 1000000,
+        [k](std::size_t n, Timer& t) { return intern_on(k, n, t); }));
+    }
+  }
+
+  std::vector<std::unique_ptr<Benchmark>> bs;
+};
+
+Intern_threads intern_threads;
+
+// A formula of about 10 tokens, with literals and names.
+const char* clause = "forall x:int. 2 * x + 12345 > y17 and ";
+
+// Lexing text with n clauses.
+Benchmark lex_text("lexer/tokens", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    std::string s = repeat(clause, n, "true");
+    t.reset();
+    Lexer lex(s);
+    std::size_t k = lex().size();
+    t.stop();
+    return k;
+  });
+
+// Returns n distinct literals of the given number of digits.
+std::vector<std::string>
+digit_strings(std::size_t n, std::size_t digits) {
+  std::vector<std::string> r;
+  r.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    std::string s(digits, '7');
+    std::string k = std::to_string(i);
+    if (k.size() < digits)
+      s.replace(digits - k.size(), k.size(), k);
+    r.push_back(s);
+  }
+  return r;
+}
+
+// Literals of up to 18 digits fit in a word. Longer ones cannot be
+// represented by the checked backends, which are given short ones.
+const std::size_t short_digits = 15;
+const std::size_t long_digits = Integer_policy::checked ? 18 : 36;
+
+// Lexing text with n comparisons against literals of the given number of
+// digits, whose values are converted from their digits.
+std::size_t
+lex_literals(std::size_t digits, std::size_t n, Timer& t) {
+  std::string s;
+  for (const std::string& lit : digit_strings(n, digits))
+    s += "x < " + lit + " and ";
+  s += "true";
+  t.reset();
+  Lexer lex(s);
+  std::size_t k = lex().size();
+  t.stop();
+  return k;
+}
+
+Benchmark lex_short("lexer/literals-short", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return lex_literals(short_digits, n, t);
+  });
+
+Benchmark lex_long("lexer/literals-long", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return lex_literals(long_digits, n, t);
+  });
+
+// Converting n literals of the given number of digits to integers, from
+// their digits as the lexer does, or from their spellings as it did
+// before. The lexer interns every spelling either way, so the spellings
+// are interned before the timer starts.
+std::size_t
+convert_literals(bool spelling, std::size_t digits, std::size_t n,
+                 Timer& t) {
+  std::vector<std::string> lits = digit_strings(n, digits);
+  std::vector<String> spellings;
+  for (const std::string& lit : lits)
+    spellings.emplace_back(lit.data(), lit.size());
+  t.reset();
+  std::size_t k = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const char* p = lits[i].data();
+    Integer v = spelling ? Integer(spellings[i])
+                         : Integer::from_digits(p, p + lits[i].size());
+    k += v.bits();
+  }
+  t.stop();
+  return k;
+}
+
+Benchmark digits_short("lexer/digits-short", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return convert_literals(false, short_digits, n, t);
+  });
+
+Benchmark spelling_short("lexer/spelling-short", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return convert_literals(true, short_digits, n, t);
+  });
+
+Benchmark digits_long("lexer/digits-long", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return convert_literals(false, long_digits, n, t);
+  });
+
+Benchmark spelling_long("lexer/spelling-long", 100000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    return convert_literals(true, long_digits, n, t);
+  });
+
+// Returns the sum of the bytes of f.
+std::size_t
+sum(const File& f) {
+  std::size_t k = 0;
+  for (char c : f)
+    k += static_cast<unsigned char>(c);
+  return k;
+}
+
+// A temporary file with n clauses, removed when it is destroyed.
+struct Temp_file {
+  explicit Temp_file(std::size_t n)
+    : path("sarah_bench.tmp") {
+    std::ofstream os(path);
+    os << repeat(clause, n, "true");
+  }
+
+  ~Temp_file() { std::remove(path.c_str()); }
+
+  std::string path;
+};
+
+// Notes the rate at which the n bytes of a file were read and scanned
+// while t ran. The timer must be stopped.
+void
+note_rate(std::size_t n, Timer& t) {
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1)
+     << n / t.elapsed() / 1000 << " MB/s";
+  t.note(ss.str());
+}
+
+// Reading and scanning a file by its path, which maps it.
+Benchmark file_path("file/path", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Temp_file tmp(n);
+    t.reset();
+    File f(tmp.path);
+    std::size_t k = sum(f);
+    t.stop();
+    note_rate(f.size(), t);
+    return k;
+  });
+
+// Reading a file by its path as File did before it was mapped: the file
+// is read into a buffer and copied into a string.
+Benchmark file_path_copy("file/path-copy", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Temp_file tmp(n);
+    t.reset();
+    std::ifstream is(tmp.path);
+    is.seekg(0, std::ios::end);
+    std::size_t size = is.tellg();
+    is.seekg(0, std::ios::beg);
+    std::unique_ptr<char[]> buf(new char[size]);
+    is.read(buf.get(), size);
+    std::string text(buf.get(), size);
+    std::size_t k = 0;
+    for (char c : text)
+      k += static_cast<unsigned char>(c);
+    t.stop();
+    note_rate(text.size(), t);
+    return k;
+  });
+
+// Reading and scanning a file through a stream.
+Benchmark file_stream("file/stream", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Temp_file tmp(n);
+    std::ifstream is(tmp.path);
+    t.reset();
+    File f(is);
+    std::size_t k = sum(f);
+    t.stop();
+    note_rate(f.size(), t);
+    return k;
+  });
+
+// Reading a stream as File did before it read blocks: a character at a
+// time through an istream_iterator.
+Benchmark file_stream_iterator("file/stream-iterator", 1000000,
+  [](std::size_t n, Timer& t) -> std::size_t {
+    Temp_file tmp(n);
+    std::ifstream is(tmp.path);
+    t.reset();
+    is >> std::noskipws;
+    std::string text{std::istream_iterator<char>(is),
+                     std::istream_iterator<char>()};
+    std::size_t k = 0;
+    for (char c : text)
+      k += static_cast<unsigned char>(c);
+    t.stop();
+    note_rate(text.size(), t);
+    return k;
+  });
+
+} // namespace
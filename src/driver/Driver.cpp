@@ -27,8 +27,10 @@ using namespace sarah;
 struct RuleSystem {
   Elaborator* language;
 
+  // Expressions are hash-consed so that same() is usually a pointer
+  // comparison in expand().
   RuleSystem() {
-    language = new Elaborator();
+    language = new Elaborator(false, true);
   }
 
   RuleSystem(Elaborator* axioms)
@@ -88,25 +90,19 @@ struct RuleSystem {
     if(is<Or, Expr>(expr))
     {
       const Or *or_ = as<Or, Expr>(&expr);
-      const Expr *left_expr = &or_->left();
-      const Expr *right_expr = &or_->right();
-
-      if ((and_or(*left_expr) == true) || (and_or(*right_expr) == true))
-        return true;
-      else
-        return false;
+      for (const Expr* e : *or_)
+        if (and_or(*e))
+          return true;
+      return false;
     }
     //check if expression is an AND
     else if (is<And, Expr>(expr))
     {
       const And *and_ = as<And, Expr>(&expr);
-      const Expr *left_expr = &and_->left();
-      const Expr *right_expr = &and_->right();
-
-      if ((and_or(*left_expr) == true) && (and_or(*right_expr) == true))
-        return true;
-      else
-        return false;
+      for (const Expr* e : *and_)
+        if (not and_or(*e))
+          return false;
+      return true;
     }
     else
     {
@@ -145,7 +141,7 @@ struct RuleSystem {
 void elaborate_string(Elaborator* language, string input)
 {
   Lexer lex(input);
-  Token_list toks = lex();
+  const Token_list& toks = lex();
 
   Parser parser(toks);
   const Tree* ast = parser();
@@ -185,18 +181,20 @@ int rule_system() {
 int translate() {
   File f(cin);
   Lexer lex(f);
-  Token_list toks = lex();
+  const Token_list& toks = lex();
 
   Parser parser(toks);
   const Tree* ast = parser();
   if (not ast) {
     cout << "invalid syntax\n";
+    return -1;
   }
 
   Elaborator elab;
   Elaboration e = elab(*ast);
   if (not e) {
     cout << "ill-formed program\n";
+    return -1;
   }
   cout << "Label 0" << endl;
 
@@ -213,8 +211,7 @@ int translate() {
 int
 main() {
   //rule_system();
-  translate();
-  return 0;
+  return translate();
   /*
   File f(cin);
 
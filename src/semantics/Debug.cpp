@@ -1,6 +1,8 @@
 
 #include <iostream>
-#include <iomanip>
+#include <vector>
+
+#include <utility/Traversal.hpp>
 
 #include "Debug.hpp"
 #include "Language.hpp"
@@ -9,94 +11,169 @@ namespace sarah {
 
 namespace {
 
+// The printer's output buffer and the base in which integers are written,
+// and the names of the quantifiers enclosing the expression being printed,
+// innermost last.
+struct Printer {
+  Output_buffer& buf;
+  int base;
+  std::vector<String> binders;
+};
+
+inline void
+print_symbol(Printer& p, char c) { p.buf.put(c); }
+
 inline void
-print_symbol(std::ostream& os, char c) { os << c; }
+print_symbol(Printer& p, const char* str) { p.buf.put(str); }
 
 inline void
-print_symbol(std::ostream& os, const char* str) { os << str; }
+print_value(Printer& p, String s) { p.buf.put(s.data(), s.size()); }
+
+inline void
+print_value(Printer& p, bool b) { p.buf.put(b ? "true" : "false"); }
+
+inline void
+print_value(Printer& p, const Integer& n) { write(p.buf, n, p.base); }
+
+// Returns the name printed before the operands of e, or nullptr if e is
+// printed as a whole.
+const char*
+node_name(const Expr& e) {
+  switch (e.tag) {
+  // Arithmetic expressions
+  case Add_kind: return "add";
+  case Sub_kind: return "sub";
+  case Mul_kind: return "mul";
+  case Div_kind: return "div";
+  case Neg_kind: return "neg";
+  case Pos_kind: return "pos";
+
+  // Relational expressions
+  case Eq_kind: return "eq";
+  case Ne_kind: return "ne";
+  case Lt_kind: return "lt";
+  case Gt_kind: return "gt";
+  case Le_kind: return "le";
+  case Ge_kind: return "ge";
+
+  // Logical expressions
+  case And_kind: return "and";
+  case Or_kind: return "or";
+  case Imp_kind: return "imp";
+  case Iff_kind: return "iff";
+  case Not_kind: return "not";
+
+  case Bind_kind: return "bind";
+  case Forall_kind: return "forall";
+  case Exists_kind: return "exists";
+
+  default: return nullptr;
+  }
+}
+
+// A bound variable is printed with the name of its binder, since a
+// variable shared by alpha-equivalent formulas has the name it was first
+// made with. A variable whose binder is not printed keeps its own name.
+void
+print_var(Printer& p, const Var& v) {
+  if (v.bound() and v.index() < p.binders.size())
+    print_value(p, p.binders[p.binders.size() - 1 - v.index()]);
+  else
+    print_value(p, v.name().str());
+}
 
-template<typename T>
-  void
-  print_atom(std::ostream& os, const Atom<T>& e) {
-    os << e.first();
+// Each term is printed as a multiplication, followed by the constant.
+void
+print_linear(Printer& p, const Linear& e) {
+  print_symbol(p, "linear(");
+  for (std::size_t i = 0; i < e.size(); ++i) {
+    print_symbol(p, "mul(");
+    print_value(p, e.coeff(i));
+    print_symbol(p, ", ");
+    print_var(p, e.var(i));
+    print_symbol(p, "), ");
   }
+  print_value(p, e.constant());
+  print_symbol(p, ')');
+}
 
-template<typename T>
-  void
-  print_structure(std::ostream& os, const Structure<T>& e) {
-    print_expr(os, e.first());
+void
+print_whole(Printer& p, const Expr& e) {
+  switch (e.tag) {
+  case Id_kind: print_value(p, as<Id>(e).str()); return;
+  case Bool_kind: print_value(p, as<Bool>(e).value()); return;
+  case Int_kind: print_value(p, as<Int>(e).value()); return;
+  case Var_kind: print_var(p, as<Var>(e)); return;
+  case Linear_kind: print_linear(p, as<Linear>(e)); return;
+  case Bool_type_kind: print_symbol(p, "bool"); return;
+  case Int_type_kind: print_symbol(p, "int"); return;
+  default: return;
   }
+}
 
-template<typename T1, typename T2>
-  void
-  print_structure(std::ostream& os, const Structure<T1, T2>& e) {
-    print_expr(os, e.first());
-    print_symbol(os, ',');
-    print_symbol(os, ' ');
-    print_expr(os, e.second());
+// Prints an expression as its name followed by its operands in
+// parentheses. The name of a quantifier's binding is in scope until the
+// quantifier is left.
+struct Print_walker : Walker<const Expr*> {
+  Print_walker(Printer& p)
+    : p(p) { }
+
+  void enter(const Expr* e, std::vector<const Expr*>& es) {
+    if (const char* str = node_name(*e)) {
+      print_symbol(p, str);
+      print_symbol(p, '(');
+      for (std::size_t i = 0; i < arity(*e); ++i)
+        es.push_back(&operand(*e, i));
+      if (const Bind* b = binding(*e))
+        p.binders.push_back(b->name().str());
+    } else {
+      print_whole(p, *e);
+    }
   }
 
-template<typename T>
-  void
-  print_node(std::ostream& os, const char* str, const T& e) {
-    print_symbol(os, str);
-    print_symbol(os, '(');
-    print_structure(os, e);
-    print_symbol(os, ')');
+  bool next(const Expr*, std::size_t i, const No_result*) {
+    if (i != 0) {
+      print_symbol(p, ',');
+      print_symbol(p, ' ');
+    }
+    return true;
   }
 
+  No_result leave(const Expr* e, No_result*, std::size_t) {
+    if (node_name(*e))
+      print_symbol(p, ')');
+    if (binding(*e))
+      p.binders.pop_back();
+    return {};
+  }
+
+  // Returns the binding of a quantifier, or nullptr.
+  static const Bind* binding(const Expr& e) {
+    if (const Exists* q = as<Exists>(&e))
+      return &q->binding();
+    if (const Forall* q = as<Forall>(&e))
+      return &q->binding();
+    return nullptr;
+  }
+
+  Printer& p;
+};
+
 } // namespace
 
 void
-print_expr(std::ostream& os, const Expr& e) {
-  struct V : Expr::Visitor {
-    V(std::ostream& os)
-      : os(os) { }
-
-    void visit(const Id& n) { print_atom(os, n); }
-    void visit(const Bool& e) { print_atom(os, e); }
-    void visit(const Int& e) { print_atom(os, e); }
-    void visit(const Var& e) { print_expr(os, e.name()); }
-
-    // Arithmetic expressions
-    void visit(const Add& e) { print_node(os, "add", e); }
-    void visit(const Sub& e) { print_node(os, "sub", e); }
-    void visit(const Mul& e) { print_node(os, "mul", e); }
-    void visit(const Div& e) { print_node(os, "div", e); }
-    void visit(const Neg& e) { print_node(os, "neg", e); }
-    void visit(const Pos& e) { print_node(os, "pos", e); }
-
-    // Relational expressions
-    void visit(const Eq& e) { print_node(os, "eq", e); }
-    void visit(const Ne& e) { print_node(os, "ne", e); }
-    void visit(const Lt& e) { print_node(os, "lt", e); }
-    void visit(const Gt& e) { print_node(os, "gt", e); }
-    void visit(const Le& e) { print_node(os, "le", e); }
-    void visit(const Ge& e) { print_node(os, "ge", e); }
-
-    // Logical expressions
-    void visit(const And& e) { print_node(os, "and", e); }
-    void visit(const Or& e) { print_node(os, "or", e); }
-    void visit(const Imp& e) { print_node(os, "imp", e); }
-    void visit(const Iff& e) { print_node(os, "iff", e); }
-    void visit(const Not& e) { print_node(os, "not", e); }
-
-    void visit(const Bind& e) { print_node(os, "bind", e); }
-    void visit(const Forall& e) { print_node(os, "forall", e); }
-    void visit(const Exists& e) { print_node(os, "exists", e); }
-
-    void visit(const Bool_type& t) { print_symbol(os, "bool"); }
-    void visit(const Int_type& t) { print_symbol(os, "int"); }
-
-    std::ostream& os;
-  };
-
-  // Print bools as true.
-  os << std::boolalpha;
-
-  V v(os);
-  e.accept(v);
+print_expr(Output_buffer& buf, const Expr& e, int base) {
+  Printer p {buf, base, {}};
+  Print_walker w(p);
+  traverse(w, &e);
 }
 
+// Render the expression into a buffer and write it out at once.
+void
+print_expr(std::ostream& os, const Expr& e) {
+  Output_buffer buf;
+  print_expr(buf, e, stream_base(os));
+  buf.flush(os);
+}
 
 } // namespace sarah
@@ -11,6 +11,12 @@ struct Expr;
 // Debugging interface
 void print_expr(std::ostream&, const Expr&);
 
+// Appends the text of an expression to the buffer. Integers are written
+// in the given base. The entire expression is rendered into the buffer
+// before anything is written to a stream, so large outputs should be
+// printed this way and flushed once.
+void print_expr(Output_buffer&, const Expr&, int base = 10);
+
 // Streaming interface
 template<typename C, typename T>
   inline std::basic_ostream<C, T>&
@@ -1,8 +1,11 @@
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <stack>
 
 #include "utility/Diagnostics.hpp"
+#include "utility/Traversal.hpp"
 #include "syntax/Tree.hpp"
 #include "syntax/Sexpr.hpp"
 
@@ -15,18 +18,19 @@ namespace sarah {
 
 namespace {
 
-Elaboration
-elab_enclosed(Elaborator& elab, const Enclosed_tree& tree) {
-  return elab(tree.arg());
-}
-
 // Returns the declaration corresponding the given name by searching
-// through the stack.
+// through the stack. Each quantifier pushes one environment, so a name
+// declared above the outermost environment is bound, and its de Bruijn
+// index is the number of environments pushed after its own.
 Elaboration
 elab_var(Elaborator& elab, const Token& tok) {
   String str = tok.spell;
-  if (const Decl* d = elab.lookup(str))
-    return {elab.make_var(d->name, *d), d->type};
+  if (const Decl* d = elab.lookup(str)) {
+    std::size_t k = Var::unbound;
+    if (std::size_t l = elab.level(str))
+      k = elab.size() - 1 - l;
+    return {elab.make_var(d->name, *d, k), d->type};
+  }
   error(tok.loc) << "no such declaration '" << str << "'\n";
   return {};
 }
@@ -38,8 +42,7 @@ elab_bool(Elaborator& elab, bool b) {
 
 Elaboration
 elab_int(Elaborator& elab, const Token& tok) {
-  Integer n = tok.spell;
-  return {elab.make_int(n), elab.int_type};
+  return {elab.make_int(take_value(tok)), elab.int_type};
 }
 
 // A type name designates a type definition, so return a variable that
@@ -99,11 +102,12 @@ make_not(Elaborator& elab, Elaboration e) {
   return {elab.make_not(e.expr()), elab.bool_type};
 }
 
-// A helper function for elaborating unary expressions.
+// A helper function for elaborating unary expressions, given the
+// elaboration e of the operand.
 template<Elaboration(*Make)(Elaborator&, Elaboration)>
   Elaboration
-  elab_unary(Elaborator& elab, const Unary_tree& tree, const Def& type) {
-  if (Elaboration e = elab(tree.arg())) {
+  elab_unary(Elaborator& elab, Elaboration e, const Def& type) {
+  if (e) {
     if (check_type(elab, e, type))
       return Make(elab, e);
   }
@@ -111,26 +115,26 @@ template<Elaboration(*Make)(Elaborator&, Elaboration)>
 }
 
 Elaboration
-elab_neg(Elaborator& elab, const Unary_tree& tree) {
-  return elab_unary<make_neg>(elab, tree, *elab.int_def);
+elab_neg(Elaborator& elab, Elaboration e) {
+  return elab_unary<make_neg>(elab, e, *elab.int_def);
 }
 
 Elaboration
-elab_pos(Elaborator& elab, const Unary_tree& tree) {
-  return elab_unary<make_pos>(elab, tree, *elab.int_def);
+elab_pos(Elaborator& elab, Elaboration e) {
+  return elab_unary<make_pos>(elab, e, *elab.int_def);
 }
 
 Elaboration
-elab_not(Elaborator& elab, const Unary_tree& tree) {
-  return elab_unary<make_not>(elab, tree, *elab.bool_def);
+elab_not(Elaborator& elab, Elaboration e) {
+  return elab_unary<make_not>(elab, e, *elab.bool_def);
 }
 
 Elaboration
-elab_unary(Elaborator& elab, const Unary_tree& tree) {
+elab_unary(Elaborator& elab, const Unary_tree& tree, Elaboration e) {
   switch (tree.op().type) {
-  case Minus_tok: return elab_neg(elab, tree);
-  case Plus_tok: return elab_pos(elab, tree);
-  case Not_tok: return elab_not(elab, tree);
+  case Minus_tok: return elab_neg(elab, e);
+  case Plus_tok: return elab_pos(elab, e);
+  case Not_tok: return elab_not(elab, e);
 
   default:
     assert(false); // Unreachable
@@ -148,13 +152,13 @@ make_name(Elaborator& elab, const Terminal_tree& tree) {
 
 // TODO: This is gross. Break it into smaller functions.
 Elaboration
-elab_bind(Elaborator& elab, const Binary_tree& tree) {
+elab_bind(Elaborator& elab, const Binary_tree& tree, Elaboration e) {
   // The name must be transformed into an Id. The syntax
   // guarantees that is an identifier.
   const Id& n = make_name(elab, as<Terminal_tree>(tree.left()));
 
-  // Elaborate the type expression.
-  if (Elaboration e = elab(tree.right())) {
+  // e is the elaboration of the type expression.
+  if (e) {
     if (const Var* v = as<Var>(&e.expr())) {
 
       // Ensure that we have a definition
@@ -234,13 +238,13 @@ make_ge(Elaborator& elab, Elaboration e1, Elaboration e2) {
 }
 
 Elaboration
-make_and(Elaborator& elab, Elaboration e1, Elaboration e2) {
-  return {elab.make_and(e1.expr(), e2.expr()), elab.bool_type};
+make_and(Elaborator& elab, Nary::Operands es) {
+  return {elab.make_and(std::move(es)), elab.bool_type};
 }
 
 Elaboration
-make_or(Elaborator& elab, Elaboration e1, Elaboration e2) {
-  return {elab.make_or(e1.expr(), e2.expr()), elab.bool_type};
+make_or(Elaborator& elab, Nary::Operands es) {
+  return {elab.make_or(std::move(es)), elab.bool_type};
 }
 
 Elaboration
@@ -253,13 +257,14 @@ make_iff(Elaborator& elab, Elaboration e1, Elaboration e2) {
   return {elab.make_iff(e1.expr(), e2.expr()), elab.bool_type};
 }
 
-// A helper function for elaborating binary expressions. Here, both
-// subexpressions must have type t.
+// A helper function for elaborating binary expressions, given the
+// elaborations es of the operands. Here, both subexpressions must have
+// type t.
 template<Elaboration(*Make)(Elaborator&, Elaboration, Elaboration)>
   Elaboration
-  elab_binary(Elaborator& elab, const Binary_tree& tree, const Def& t) {
-    if (Elaboration e1 = elab(tree.left()))
-      if (Elaboration e2 = elab(tree.right()))
+  elab_binary(Elaborator& elab, const Elaboration* es, const Def& t) {
+    if (Elaboration e1 = es[0])
+      if (Elaboration e2 = es[1])
         if (check_type(elab, e1, t) and check_type(elab, e2, t))
           return Make(elab, e1, e2);
     return {};
@@ -271,9 +276,9 @@ template<Elaboration(*Make)(Elaborator&, Elaboration, Elaboration)>
 // n | x for numeral n.
 template<Elaboration(*Make)(Elaborator&, Elaboration, Elaboration)>
   Elaboration
-  elab_multiplicative(Elaborator& elab, const Binary_tree& tree, const Def& t) {
-    if (Elaboration e1 = elab(tree.left()))
-      if (Elaboration e2 = elab(tree.right()))
+  elab_multiplicative(Elaborator& elab, const Elaboration* es, const Def& t) {
+    if (Elaboration e1 = es[0])
+      if (Elaboration e2 = es[1])
         if (is<Int>(e1.expr()) and check_type(elab, e2, t))
           return Make(elab, e1, e2);
     return {};
@@ -281,87 +286,130 @@ template<Elaboration(*Make)(Elaborator&, Elaboration, Elaboration)>
 
 
 
+// Appends the operands of a chain of the same associative operator, as
+// parsed by parse_left, to ts. The operands are found along the left
+// spine of the tree.
+void
+spine_operands(const Binary_tree& tree, std::vector<const Tree*>& ts) {
+  std::size_t first = ts.size();
+  const Tree* left = &tree;
+  while (const Binary_tree* b = as<Binary_tree>(left)) {
+    if (b->op().type != tree.op().type)
+      break;
+    ts.push_back(&b->right());
+    left = &b->left();
+  }
+  ts.push_back(left);
+  std::reverse(ts.begin() + first, ts.end());
+}
+
+// A helper function for elaborating such a chain into a single n-ary
+// expression, given the elaborations es of its n operands. As with
+// binary expressions, all operands are elaborated before any is checked
+// to have type t.
+template<Elaboration(*Make)(Elaborator&, Nary::Operands)>
+  Elaboration
+  elab_nary(Elaborator& elab, const Elaboration* es, std::size_t n,
+            const Def& t) {
+    for (std::size_t i = 0; i < n; ++i)
+      if (not es[i])
+        return {};
+
+    Nary::Operands ops;
+    ops.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      if (not check_type(elab, es[i], t))
+        return {};
+      ops.push_back(&es[i].expr());
+    }
+    return Make(elab, std::move(ops));
+  }
+
 Elaboration
-elab_add(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_add>(elab, tree, *elab.int_def);
+elab_add(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_add>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_sub(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_sub>(elab, tree, *elab.int_def);
+elab_sub(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_sub>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_mul(Elaborator& elab, const Binary_tree& tree) {
-  return elab_multiplicative<make_mul>(elab, tree, *elab.int_def);
+elab_mul(Elaborator& elab, const Elaboration* es) {
+  return elab_multiplicative<make_mul>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_div(Elaborator& elab, const Binary_tree& tree) {
-  return elab_multiplicative<make_div>(elab, tree, *elab.int_def);
+elab_div(Elaborator& elab, const Elaboration* es) {
+  return elab_multiplicative<make_div>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_eq(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_eq>(elab, tree, *elab.int_def);
+elab_eq(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_eq>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_ne(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_ne>(elab, tree, *elab.int_def);
+elab_ne(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_ne>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_lt(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_lt>(elab, tree, *elab.int_def);
+elab_lt(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_lt>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_gt(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_gt>(elab, tree, *elab.int_def);
+elab_gt(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_gt>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_le(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_le>(elab, tree, *elab.int_def);
+elab_le(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_le>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_ge(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_ge>(elab, tree, *elab.int_def);
+elab_ge(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_ge>(elab, es, *elab.int_def);
 }
 
 Elaboration
-elab_and(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_and>(elab, tree, *elab.bool_def);
+elab_and(Elaborator& elab, const Elaboration* es, std::size_t n) {
+  return elab_nary<make_and>(elab, es, n, *elab.bool_def);
 }
 
 Elaboration
-elab_or(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_or>(elab, tree, *elab.bool_def);
+elab_or(Elaborator& elab, const Elaboration* es, std::size_t n) {
+  return elab_nary<make_or>(elab, es, n, *elab.bool_def);
 }
 
 Elaboration
-elab_imp(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_imp>(elab, tree, *elab.bool_def);
+elab_imp(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_imp>(elab, es, *elab.bool_def);
 }
 
 Elaboration
-elab_iff(Elaborator& elab, const Binary_tree& tree) {
-  return elab_binary<make_iff>(elab, tree, *elab.bool_def);
+elab_iff(Elaborator& elab, const Elaboration* es) {
+  return elab_binary<make_iff>(elab, es, *elab.bool_def);
 }
 
 // A helper class for managing scopes during elaboration. This
 // creates a new environment that is pushed onto the stack when
-// constructed and popped when it's destroyed.
+// constructed and popped when it's destroyed. Expressions made in
+// the scope are released unless the scope is kept.
 struct Quantifier_scope {
   Quantifier_scope(Elaborator& e)
-    : elab(e), env() { elab.push(env); }
+    : elab(e), env(), nodes(e) { elab.push(env); }
 
   ~Quantifier_scope() { elab.pop(); }
 
+  void keep() { nodes.keep(); }
+
   Elaborator& elab;
   Environment env;
+  Factory_scope nodes;
 };
 
 // Helper functions for creating elaborations
@@ -375,66 +423,78 @@ make_exists(Elaborator& elab, Elaboration e1, Elaboration e2) {
   return {elab.make_exists(as<Bind>(e1.expr()), e2.expr()), elab.bool_type};
 }
 
+// Registers the binding elaborated as e in the quantifier's scope, before
+// its body is elaborated.
+void
+declare_binding(Elaborator& elab, Elaboration e) {
+  const Bind& b = as<Bind>(e.expr());
+  elab.declare(b.name(), b.type());
+}
+
+// A helper function for elaborating quantifiers, given the elaborations
+// of the binding and body. The quantifier's scope is released unless the
+// quantifier can be elaborated.
 template<Elaboration (*Make)(Elaborator&, Elaboration, Elaboration)>
   Elaboration
-  elab_quantifier(Elaborator& elab, const Binary_tree& tree) {
-    // Elaborate the binding. If it failed, bail out. Otherwise,
-    // the syntax guarantees that e1 is a bind expression.
-    Elaboration e1 = elab(tree.left());
+  elab_quantifier(Elaborator& elab, const Elaboration* es,
+                  Quantifier_scope& scope) {
+    // If the binding failed, bail out. Otherwise, the syntax
+    // guarantees that e1 is a bind expression.
+    Elaboration e1 = es[0];
     if (not e1)
       return e1;
-    const Bind& b = as<Bind>(e1.expr());
 
-    // Create a new environment, push it onto the stack
-    // and register the binding.
-    Quantifier_scope scope = elab;
-    elab.declare(b.name(), b.type());
-
-    // Now, elaborate the 2nd expression and ensure that it
-    // is a boolean expression.
-    if (Elaboration e2 = elab(tree.right()))
-      if (check_type(elab, e2, *elab.bool_def))
+    // Ensure that the body is a boolean expression. If it isn't,
+    // discard whatever was made for it.
+    if (Elaboration e2 = es[1])
+      if (check_type(elab, e2, *elab.bool_def)) {
+        scope.keep();
         return Make(elab, e1, e2);
+      }
     return {};
   }
 
 Elaboration
-elab_forall(Elaborator& elab, const Binary_tree& tree) {
-  return elab_quantifier<make_forall>(elab, tree);
+elab_forall(Elaborator& elab, const Elaboration* es, Quantifier_scope& scope) {
+  return elab_quantifier<make_forall>(elab, es, scope);
 }
 
 Elaboration
-elab_exists(Elaborator& elab, const Binary_tree& tree) {
-  return elab_quantifier<make_exists>(elab, tree);
+elab_exists(Elaborator& elab, const Elaboration* es, Quantifier_scope& scope) {
+  return elab_quantifier<make_exists>(elab, es, scope);
+}
+
+inline bool
+is_quantifier(const Binary_tree& tree) {
+  return tree.op().type == Forall_tok or tree.op().type == Exists_tok;
 }
 
 Elaboration
-elab_binary(Elaborator& elab, const Binary_tree& tree) {
+elab_binary(Elaborator& elab, const Binary_tree& tree,
+            const Elaboration* es, std::size_t n) {
   switch (tree.op().type) {
   // Arithmetic operators
-  case Plus_tok: return elab_add(elab, tree);
-  case Minus_tok: return elab_sub(elab, tree);
-  case Star_tok: return elab_mul(elab, tree);
-  case Div_tok: return elab_div(elab, tree);
+  case Plus_tok: return elab_add(elab, es);
+  case Minus_tok: return elab_sub(elab, es);
+  case Star_tok: return elab_mul(elab, es);
+  case Div_tok: return elab_div(elab, es);
 
   // Relational operators
-  case Equal_equal_tok: return elab_eq(elab, tree);
-  case Not_equal_tok: return elab_ne(elab, tree);
-  case Less_tok: return elab_lt(elab, tree);
-  case Greater_tok: return elab_gt(elab, tree);
-  case Less_equal_tok: return elab_le(elab, tree);
-  case Greater_equal_tok: return elab_ge(elab, tree);
+  case Equal_equal_tok: return elab_eq(elab, es);
+  case Not_equal_tok: return elab_ne(elab, es);
+  case Less_tok: return elab_lt(elab, es);
+  case Greater_tok: return elab_gt(elab, es);
+  case Less_equal_tok: return elab_le(elab, es);
+  case Greater_equal_tok: return elab_ge(elab, es);
 
   // Logical operators
-  case And_tok: return elab_and(elab, tree);
-  case Or_tok: return elab_or(elab, tree);
-  case Imp_tok: return elab_imp(elab, tree);
-  case Iff_tok: return elab_iff(elab, tree);
+  case And_tok: return elab_and(elab, es, n);
+  case Or_tok: return elab_or(elab, es, n);
+  case Imp_tok: return elab_imp(elab, es);
+  case Iff_tok: return elab_iff(elab, es);
 
-  // Quantifiers
-  case Colon_tok: return elab_bind(elab, tree);
-  case Forall_tok: return elab_forall(elab, tree);
-  case Exists_tok: return elab_exists(elab, tree);
+  // Bindings
+  case Colon_tok: return elab_bind(elab, tree, es[0]);
 
   default:
     assert(false); // Unreachable
@@ -442,37 +502,90 @@ elab_binary(Elaborator& elab, const Binary_tree& tree) {
   return Elaboration();
 }
 
-} // namespace
-
-Elaboration
-Elaborator::operator()(const Tree& tree) {
-  struct V : Tree::Visitor {
-    V(Elaborator& e)
-      : elab(e) { }
-
-    void visit(const Enclosed_tree& tree) {
-      result = elab_enclosed(elab, tree);
+// Elaborates the operands of a tree before the tree itself. The name in
+// a binding is not elaborated, and a chain of the same associative
+// logical operator is elaborated as one n-ary expression. An operand is
+// elaborated only when the operands before it were.
+struct Elab_walker : Walker<const Tree*, Elaboration> {
+  Elab_walker(Elaborator& e)
+    : elab(e) { }
+
+  void enter(const Tree* t, std::vector<const Tree*>& ts) {
+    switch (t->tag) {
+    case Enclosed_tree_kind:
+      ts.push_back(&as<Enclosed_tree>(*t).arg());
+      return;
+    case Terminal_tree_kind:
+      return;
+    case Unary_tree_kind:
+      ts.push_back(&as<Unary_tree>(*t).arg());
+      return;
+    case Binary_tree_kind: {
+      const Binary_tree& b = as<Binary_tree>(*t);
+      switch (b.op().type) {
+      case Colon_tok:
+        ts.push_back(&b.right());
+        return;
+      case And_tok: case Or_tok:
+        spine_operands(b, ts);
+        return;
+      default:
+        ts.push_back(&b.left());
+        ts.push_back(&b.right());
+        return;
+      }
     }
-
-    void visit(const Terminal_tree& tree) {
-      result = elab_terminal(elab, tree);
     }
+  }
 
-    void visit(const Unary_tree& tree) {
-      result = elab_unary(elab, tree);
+  // Create a new environment for a quantifier and push it onto the
+  // stack before its binding is elaborated. Any expressions made for
+  // the quantifier are released if it cannot be elaborated.
+  bool next(const Tree* t, std::size_t i, const Elaboration* es) {
+    const Binary_tree* b = as<Binary_tree>(t);
+    if (b and is_quantifier(*b)) {
+      if (i == 0)
+        scopes.emplace(elab);
+      else if (es[0])
+        declare_binding(elab, es[0]);
     }
+    return i == 0 or es[i - 1];
+  }
 
-    void visit(const Binary_tree& tree) {
-      result = elab_binary(elab, tree);
+  Elaboration leave(const Tree* t, Elaboration* es, std::size_t n) {
+    switch (t->tag) {
+    case Enclosed_tree_kind:
+      return es[0];
+    case Terminal_tree_kind:
+      return elab_terminal(elab, as<Terminal_tree>(*t));
+    case Unary_tree_kind:
+      return elab_unary(elab, as<Unary_tree>(*t), es[0]);
+    case Binary_tree_kind:
+      break;
     }
 
-    Elaborator& elab;
-    Elaboration result;
-  };
+    const Binary_tree& b = as<Binary_tree>(*t);
+    if (not is_quantifier(b))
+      return elab_binary(elab, b, es, n);
+    Elaboration e;
+    if (b.op().type == Forall_tok)
+      e = elab_forall(elab, es, scopes.top());
+    else
+      e = elab_exists(elab, es, scopes.top());
+    scopes.pop();
+    return e;
+  }
+
+  Elaborator& elab;
+  std::stack<Quantifier_scope> scopes;
+};
 
-  V vis(*this);
-  tree.accept(vis);
-  return vis.result;
+} // namespace
+
+Elaboration
+Elaborator::operator()(const Tree& tree) {
+  Elab_walker w(*this);
+  return traverse(w, &tree);
 }
 
 const Elaboration
@@ -39,6 +39,8 @@ struct Elaboration : std::pair<const Expr*, const Type*> {
 // we'd support multiple front-end elaborators. It is tempting to move this
 // class into the syntax repository.
 struct Elaborator : Context {
+  explicit Elaborator(bool use_arena = false, bool hash_cons = false)
+    : Context(use_arena, hash_cons) { }
 
   std::vector<Elaboration> elaborations;
 
@@ -1,6 +1,11 @@
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
+#include <utility>
 
 #include "Language.hpp"
 
@@ -9,38 +14,246 @@ namespace sarah {
 // -------------------------------------------------------------------------- //
 // Environment
 
-Environment::~Environment() {
-  for(auto p : *this)
-    delete p.second;
-}
+Environment::Environment()
+  : slots(local), mask(local_size - 1), count(0), local() { }
 
-// Insert the declaration binding n : t into the environment.
-const Decl&
-Environment::declare(const Id& n, const Type& t) {
-  assert(no_binding(n.str()));
-  Decl* d = new Decl(n, t);
-  insert({n.str(), d});
-  return *d;
+Environment::~Environment() {
+  if (slots != local)
+    delete[] slots;
 }
 
-// Insert the definition binding n : t -> e into the environment.
-const Def&
-Environment::define(const Id& n, const Type& t, const Expr& e) {
-  assert(no_binding(n.str()));
-  Def *d = new Def(n, t, e);
-  insert({n.str(), d});
-  return *d;
+// Symbol ids are dense, so they are used as hashes directly. The table
+// grows before it is three quarters full, so a probe always ends at an
+// empty slot.
+void
+Environment::bind(const Decl& d) {
+  assert(no_binding(d.name.str()));
+  if (4 * (count + 1) > 3 * (mask + 1))
+    grow();
+  std::uint32_t sym = d.name.str().id();
+  std::size_t i = sym & mask;
+  while (slots[i].decl)
+    i = (i + 1) & mask;
+  slots[i] = {&d, sym};
+  ++count;
 }
 
 // Return a pointer to the declaration binding indicated by str or
 // nullptr if no such binding exists.
 const Decl*
 Environment::lookup(String str) const {
-  auto i = find(str);
-  if (i == end())
-    return nullptr;
-  else
-    return i->second;
+  std::uint32_t sym = str.id();
+  for (std::size_t i = sym & mask; slots[i].decl; i = (i + 1) & mask)
+    if (slots[i].sym == sym)
+      return slots[i].decl;
+  return nullptr;
+}
+
+// Double the number of slots, and reinsert every binding.
+void
+Environment::grow() {
+  Slot* old = slots;
+  std::size_t n = mask + 1;
+  slots = new Slot[2 * n]();
+  mask = 2 * n - 1;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (not old[i].decl)
+      continue;
+    std::size_t j = old[i].sym & mask;
+    while (slots[j].decl)
+      j = (j + 1) & mask;
+    slots[j] = old[i];
+  }
+  if (old != local)
+    delete[] old;
+}
+
+// -------------------------------------------------------------------------- //
+// Persistent environment
+
+// A node of a persistent environment. The bitmap has a bit for each of
+// the 32 entries a node can hold, set when the entry is occupied, and
+// the leaves bitmap marks the occupied entries that are declarations
+// rather than nodes. The entries are stored after the node, in the order
+// of their bits. Nodes are shared, and freed with their last reference.
+struct Persistent_environment::Node {
+  union Entry {
+    const Decl* decl;
+    const Node* node;
+  };
+
+  static constexpr unsigned bits = 5;
+
+  Node(std::uint32_t b, std::uint32_t l)
+    : refs(1), bitmap(b), leaves(l) { }
+
+  std::size_t size() const { return __builtin_popcount(bitmap); }
+
+  Entry* entries() { return reinterpret_cast<Entry*>(this + 1); }
+  const Entry* entries() const {
+    return reinterpret_cast<const Entry*>(this + 1);
+  }
+
+  // Returns the bit of the entry for sym in a node at the given shift.
+  static std::uint32_t bit(std::uint32_t sym, unsigned shift) {
+    return std::uint32_t(1) << ((sym >> shift) & 31);
+  }
+
+  // Returns the position of the entry with the given bit.
+  std::size_t position(std::uint32_t b) const {
+    return __builtin_popcount(bitmap & (b - 1));
+  }
+
+  static std::uint32_t key(const Decl& d) { return d.name.str().id(); }
+
+  static Node* make(std::uint32_t, std::uint32_t);
+  static Node* copy(const Node*, std::uint32_t, std::uint32_t, std::size_t);
+  static void retain(const Node*);
+  static void release(const Node*);
+  static const Node* insert(const Node*, std::uint32_t, const Decl&,
+                            unsigned, bool&);
+
+  mutable std::atomic<std::size_t> refs;
+  std::uint32_t bitmap;
+  std::uint32_t leaves;
+};
+
+constexpr unsigned Persistent_environment::Node::bits;
+
+// Returns a node with the bitmaps b and l and one reference. Its entries
+// are uninitialized.
+Persistent_environment::Node*
+Persistent_environment::Node::make(std::uint32_t b, std::uint32_t l) {
+  std::size_t n = __builtin_popcount(b);
+  void* p = ::operator new(sizeof(Node) + n * sizeof(Entry));
+  return new (p) Node(b, l);
+}
+
+// Returns a copy of n with the bitmaps b and l, which add an empty entry
+// at position i when they have one more bit than n. Nodes are retained
+// by the copy.
+Persistent_environment::Node*
+Persistent_environment::Node::copy(const Node* n, std::uint32_t b,
+                                   std::uint32_t l, std::size_t i) {
+  Node* r = make(b, l);
+  std::size_t gap = r->size() - n->size();
+  const Entry* src = n->entries();
+  Entry* dst = r->entries();
+  std::copy(src, src + i, dst);
+  std::copy(src + i, src + n->size(), dst + i + gap);
+  std::size_t j = 0;
+  for (std::uint32_t m = n->bitmap; m; m &= m - 1, ++j)
+    if (not (n->leaves & (m & -m)))
+      retain(src[j].node);
+  return r;
+}
+
+void
+Persistent_environment::Node::retain(const Node* n) {
+  if (n)
+    n->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Releasing the last reference to a node releases its children. The
+// depth of a trie is at most 7, so this recursion is shallow.
+void
+Persistent_environment::Node::release(const Node* n) {
+  if (not n or n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+  std::size_t j = 0;
+  for (std::uint32_t m = n->bitmap; m; m &= m - 1, ++j)
+    if (not (n->leaves & (m & -m)))
+      release(n->entries()[j].node);
+  n->~Node();
+  ::operator delete(const_cast<Node*>(n));
+}
+
+// Returns a copy of the trie n, at the given shift, with d bound to sym,
+// and sets added when sym was not already bound. Only the path to d is
+// copied. Two symbols in the same entry are split into a new node at the
+// next shift; they differ in some bits, so splitting ends by the last.
+const Persistent_environment::Node*
+Persistent_environment::Node::insert(const Node* n, std::uint32_t sym,
+                                     const Decl& d, unsigned shift,
+                                     bool& added) {
+  assert(shift < 32);
+  std::uint32_t b = bit(sym, shift);
+  if (not n) {
+    Node* r = make(b, b);
+    r->entries()[0].decl = &d;
+    added = true;
+    return r;
+  }
+
+  std::size_t i = n->position(b);
+  if (not (n->bitmap & b)) {
+    Node* r = copy(n, n->bitmap | b, n->leaves | b, i);
+    r->entries()[i].decl = &d;
+    added = true;
+    return r;
+  }
+
+  Node* r = copy(n, n->bitmap, n->leaves, i);
+  Entry& e = r->entries()[i];
+  if (not (n->leaves & b)) {
+    const Node* c = e.node;
+    e.node = insert(c, sym, d, shift + bits, added);
+    release(c);
+  } else if (key(*e.decl) == sym) {
+    e.decl = &d;
+  } else {
+    bool split;
+    const Node* c = insert(nullptr, key(*e.decl), *e.decl, shift + bits,
+                           split);
+    e.node = insert(c, sym, d, shift + bits, added);
+    release(c);
+    r->leaves &= ~b;
+  }
+  return r;
+}
+
+Persistent_environment::Persistent_environment(
+  const Persistent_environment& e)
+  : root(e.root), count(e.count) { Node::retain(root); }
+
+Persistent_environment::Persistent_environment(Persistent_environment&& e)
+  : root(e.root), count(e.count) {
+  e.root = nullptr;
+  e.count = 0;
+}
+
+Persistent_environment&
+Persistent_environment::operator=(Persistent_environment e) {
+  std::swap(root, e.root);
+  std::swap(count, e.count);
+  return *this;
+}
+
+Persistent_environment::~Persistent_environment() {
+  Node::release(root);
+}
+
+Persistent_environment
+Persistent_environment::bind(const Decl& d) const {
+  bool added = false;
+  const Node* r = Node::insert(root, Node::key(d), d, 0, added);
+  return Persistent_environment(r, count + added);
+}
+
+const Decl*
+Persistent_environment::lookup(String s) const {
+  std::uint32_t sym = s.id();
+  const Node* n = root;
+  for (unsigned shift = 0; n; shift += Node::bits) {
+    std::uint32_t b = Node::bit(sym, shift);
+    if (not (n->bitmap & b))
+      return nullptr;
+    const Node::Entry& e = n->entries()[n->position(b)];
+    if (n->leaves & b)
+      return Node::key(*e.decl) == sym ? e.decl : nullptr;
+    n = e.node;
+  }
+  return nullptr;
 }
 
 // -------------------------------------------------------------------------- //
@@ -51,30 +264,119 @@ Environment::lookup(String str) const {
 // allowed. Maybe we need a can_declare/can_define predicate that guarantees
 // the viability of the operation.
 
-// Add n : t to the current binding environment.
-const Decl&
-Stack::declare(const Id& n, const Type& t) {
-  return top().declare(n, t);
+void
+Stack::push(Environment& e) {
+  assert(e.size() == 0);
+  Base::push_back(&e);
+  marks.push_back(shadows.size());
+  saved.push_back(current);
 }
 
-// Add n : t -> e to the current binding environment.
-const Def&
-Stack::define(const Id& n, const Type& t, const Expr& e) {
-  return top().define(n, t, e);
+// Restore the declarations shadowed by those in the top environment, in
+// the reverse order of their shadowing.
+void
+Stack::pop() {
+  std::size_t mark = marks.back();
+  while (shadows.size() > mark) {
+    const Shadow& s = shadows.back();
+    visible[s.sym] = s.prev;
+    shadows.pop_back();
+  }
+  marks.pop_back();
+  current = std::move(saved.back());
+  saved.pop_back();
+  Base::pop_back();
 }
 
-// Search the stack for the given name. The search walks down the stack,
-// starting with the most recently pushed environment.
+// Bind d in the top environment, making it the visible declaration of
+// its name.
+void
+Stack::bind(const Decl& d) {
+  top().bind(d);
+  std::uint32_t sym = d.name.str().id();
+  if (sym >= visible.size())
+    visible.resize(sym + 1, {nullptr, 0});
+  shadows.push_back({sym, visible[sym]});
+  visible[sym] = {&d, Base::size() - 1};
+  current = current.bind(d);
+}
+
+// Return the innermost declaration of the given name, or nullptr if
+// there is none.
 const Decl*
 Stack::lookup(String s) const {
-  for(auto i = rbegin(); i != rend(); ++i) {
-    const Environment* env = *i;
-    if (const Decl* d = env->lookup(s))
-      return d;
-  }
+  std::uint32_t sym = s.id();
+  if (sym < visible.size())
+    return visible[sym].decl;
   return nullptr;
 }
 
+// Return the level of the environment declaring the innermost binding
+// of the given name.
+std::size_t
+Stack::level(String s) const {
+  assert(has_binding(s));
+  return visible[s.id()].level;
+}
+
+// -------------------------------------------------------------------------- //
+// Variables
+
+constexpr std::size_t Var::unbound;
+
+// -------------------------------------------------------------------------- //
+// Operands
+
+std::size_t
+arity(const Expr& e) {
+  switch (e.tag) {
+  case Id_kind: case Bool_kind: case Int_kind:
+  case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+    return 0;
+  case Var_kind: case Neg_kind: case Pos_kind: case Not_kind:
+    return 1;
+  case Linear_kind:
+    return as<Linear>(e).size();
+  case And_kind: case Or_kind:
+    return as<Nary>(e).size();
+  default:
+    return 2;
+  }
+}
+
+namespace {
+
+template<typename T1, typename T2>
+  inline const Expr&
+  pick(const Structure<T1, T2>& e, std::size_t i) {
+    if (i == 0)
+      return e.first();
+    return e.second();
+  }
+
+} // namespace
+
+const Expr&
+operand(const Expr& e, std::size_t i) {
+  assert(i < arity(e));
+  switch (e.tag) {
+  case Var_kind: return as<Var>(e).name();
+  case Neg_kind: case Pos_kind: case Not_kind: return as<Unary>(e).arg();
+  case Linear_kind: return as<Linear>(e).var(i);
+  case And_kind: case Or_kind: return as<Nary>(e).operand(i);
+  case Mul_kind: return pick(as<Mul>(e), i);
+  case Div_kind: return pick(as<Div>(e), i);
+  case Bind_kind: return pick(as<Bind>(e), i);
+  case Exists_kind: return pick(as<Exists>(e), i);
+  case Forall_kind: return pick(as<Forall>(e), i);
+  default: {
+    const Binary& b = as<Binary>(e);
+    return i == 0 ? b.left() : b.right();
+  }
+  }
+}
+
+
 // -------------------------------------------------------------------------- //
 // Expression equality
 
@@ -89,99 +391,234 @@ same_bool(const Bool& a, const Bool& b) { return a.value() == b.value(); }
 inline bool
 same_int(const Int& a, const Int& b) { return a.value() == b.value(); }
 
+// Bound variables are the same when they have the same index and type,
+// and other variables when they refer to the same declaration.
 inline bool
-same_var(const Var& a, const Var& b) { return &a.decl() == &b.decl(); }
+same_var(const Var& a, const Var& b) {
+  if (a.bound() or b.bound())
+    return a.index() == b.index() and &a.type() == &b.type();
+  return &a.decl() == &b.decl();
+}
 
 // Two types are the same only when they are the same object.
 inline bool
 same_type(const Type& a, const Type& b) { return &a == &b; }
 
-// Here we're saying that two binary exprs are the same if they are identical
-inline bool
-same_binary(const Binary& a, const Binary& b) {
-  return same(a.left(),b.left()) and same(a.right(),b.right());
+// Returns a negative number, zero or a positive number as a precedes, is
+// or follows b. Types are ordered by kind and then by identity.
+inline int
+order_type(const Type& a, const Type& b) {
+  if (a.tag != b.tag)
+    return a.tag < b.tag ? -1 : 1;
+  if (&a == &b)
+    return 0;
+  return std::less<const Type*>()(&a, &b) ? -1 : 1;
 }
 
-inline bool
-same_multiplicative(const Structure<Int,Expr>& a,
-                    const Structure<Int,Expr>& b) {
-  return same(a.first(),b.first()) and same(a.second(),b.second());
+// Orders variables consistently with same_var(). Bound variables come
+// first, ordered by index and then type. The rest are ordered by name
+// and then by declaration.
+inline int
+order_var(const Var& a, const Var& b) {
+  if (a.bound() != b.bound())
+    return a.bound() ? -1 : 1;
+  if (a.bound()) {
+    if (a.index() != b.index())
+      return a.index() < b.index() ? -1 : 1;
+    return order_type(a.type(), b.type());
+  }
+  std::uint32_t x = a.name().str().id();
+  std::uint32_t y = b.name().str().id();
+  if (x != y)
+    return x < y ? -1 : 1;
+  if (&a.decl() == &b.decl())
+    return 0;
+  return std::less<const Decl*>()(&a.decl(), &b.decl()) ? -1 : 1;
 }
 
+inline int
+order_int(const Integer& a, const Integer& b) {
+  if (a == b)
+    return 0;
+  return a < b ? -1 : 1;
+}
+
+// The names of bindings are ignored.
 inline bool
-same_bind(const Structure<Id,Type>& a, const Structure<Id,Type>& b) {
-  return same(a.first(),b.first()) and same(a.second(),b.second());
+same_bind(const Bind& a, const Bind& b) {
+  return same_type(a.type(), b.type());
 }
 
+// The variables of linear terms are in canonical order.
 inline bool
-same_quantifier(const Structure<Bind,Expr>& a, const Structure<Bind,Expr>& b) {
-  return same(a.first(),b.first()) and same(a.second(),b.second());
+same_linear(const Linear& a, const Linear& b) {
+  if (a.size() != b.size() or a.constant() != b.constant())
+    return false;
+  for (std::size_t i = 0; i < a.size(); ++i)
+    if (not same_var(a.var(i), b.var(i)) or a.coeff(i) != b.coeff(i))
+      return false;
+  return true;
 }
 
+// Returns true when a and b are distinct nodes of the same hash-consing
+// table, and so are not the same. Bindings are consed by name, which is
+// not compared, so distinct bindings may still be the same.
 inline bool
-same_unary(const Unary& a, const Unary& b) {
-  return same(a.arg(),b.arg());
+distinct_conses(const Expr& a, const Expr& b) {
+  return a.table and a.table == b.table and kind(a) != Bind_kind;
 }
 
+// Returns true when the expressions a and b are compared by their
+// operands. Expressions with different hashes are never the same, and
+// expressions from the same hash-consing table are compared by identity.
+// Literals, variables, linear terms, bindings and types are compared as
+// a whole.
 bool
-same_expr(const Expr& a, const Expr& b) {
-  struct V : Expr::Visitor {
-    V(const Expr& e)
-      : expr(e), result(false) { }
-
-    void visit(const Id& e) { result = same_id(e, as<Id>(expr)); }
-    void visit(const Bool& e) { result = same_bool(e, as<Bool>(expr)); }
-    void visit(const Int& e) { result = same_int(e, as<Int>(expr)); }
-    void visit(const Var& e) { result = same_var(e, as<Var>(expr)); }
-
-    // TODO: Implement these functions.
-
-    void visit(const Add& e) { result = same_binary(e,as<Add>(expr)); }
-    void visit(const Sub& e) { result = same_binary(e,as<Sub>(expr)); }
-    void visit(const Mul& e) { result = same_multiplicative(e,as<Mul>(expr)); }
-    void visit(const Div& e) { result = same_multiplicative(e,as<Div>(expr)); }
-    void visit(const Neg& e) { result = same_unary(e,as<Neg>(expr)); }
-    void visit(const Pos& e) { result = same_unary(e,as<Pos>(expr));}
-
-    void visit(const Eq& e) { result = same_binary(e,as<Eq>(expr)); }
-    void visit(const Ne& e) { result = same_binary(e,as<Ne>(expr)); }
-    void visit(const Lt& e) { result = same_binary(e,as<Lt>(expr)); }
-    void visit(const Gt& e) { result = same_binary(e,as<Gt>(expr)); }
-    void visit(const Le& e) { result = same_binary(e,as<Le>(expr)); }
-    void visit(const Ge& e) { result = same_binary(e,as<Ge>(expr)); }
-
-    void visit(const And& e) { result = same_binary(e,as<And>(expr)); }
-    void visit(const Or& e) { result = same_binary(e,as<Or>(expr)); }
-    void visit(const Imp& e) { result = same_binary(e,as<Imp>(expr)); }
-    void visit(const Iff& e) { result = same_binary(e,as<Iff>(expr)); }
-    void visit(const Not& e) { result = same_unary(e,as<Not>(expr));}
-    void visit(const Bind& e) { result = same_bind(e,as<Bind>(expr));}
-
-    void visit(const Exists& e) {
-      result = same_quantifier(e,as<Exists>(expr));
-    }
-    void visit(const Forall& e) {
-      result = same_quantifier(e,as<Forall>(expr));
-    }
+compare_operands(const Expr& a, const Expr& b) {
+  if (&a == &b or hash(a) != hash(b) or kind(a) != kind(b))
+    return false;
+  if (distinct_conses(a, b))
+    return false;
+  switch (a.tag) {
+  case Id_kind: case Bool_kind: case Int_kind: case Var_kind:
+  case Linear_kind: case Bind_kind:
+  case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+    return false;
+  default:
+    return arity(a) == arity(b);
+  }
+}
 
-    void visit_type(const Type& t) { result = same_type(t, as<Type>(expr)); }
+// Compares an expression with b, which has the same kind, when their
+// operands are not compared.
+struct Same_fn {
+  template<typename T>
+    const T& other() const { return static_cast<const T&>(b); }
 
-    const Expr& expr;
-    bool result;
-  };
+  bool operator()(const Id& a) { return same_id(a, other<Id>()); }
+  bool operator()(const Bool& a) { return same_bool(a, other<Bool>()); }
+  bool operator()(const Int& a) { return same_int(a, other<Int>()); }
+  bool operator()(const Var& a) { return same_var(a, other<Var>()); }
+  bool operator()(const Linear& a) { return same_linear(a, other<Linear>()); }
+  bool operator()(const Bind& a) { return same_bind(a, other<Bind>()); }
+  bool operator()(const Type& a) { return same_type(a, other<Type>()); }
 
-  V vis(b);
-  a.accept(vis);
-  return vis.result;
+  // Other expressions differ in their number of operands.
+  bool operator()(const Expr& a) { return false; }
+
+  const Expr& b;
+};
+
+bool
+same_whole(const Expr& a, const Expr& b) {
+  if (&a == &b)
+    return true;
+  if (hash(a) != hash(b) or kind(a) != kind(b))
+    return false;
+  if (distinct_conses(a, b))
+    return false;
+  return visit(a, Same_fn{b});
+}
+
+using Expr_pair = std::pair<const Expr*, const Expr*>;
+
+// Compares the operands of a and b. Pairs of operands that are compared
+// by their own operands are added to the worklist.
+bool
+same_operands(const Expr& a, const Expr& b, std::vector<Expr_pair>& work) {
+  for (std::size_t i = 0; i < arity(a); ++i) {
+    const Expr& x = operand(a, i);
+    const Expr& y = operand(b, i);
+    if (compare_operands(x, y))
+      work.emplace_back(&x, &y);
+    else if (not same_whole(x, y))
+      return false;
+  }
+  return true;
+}
+
+// Orders a and b, which have the same kind, consistently with same()
+// when their operands are not compared. Expressions that are compared by
+// their operands are ordered here by their number of operands.
+int
+order_whole(const Expr& a, const Expr& b) {
+  switch (a.tag) {
+  case Id_kind: {
+    std::uint32_t x = as<Id>(a).str().id();
+    std::uint32_t y = as<Id>(b).str().id();
+    return x == y ? 0 : (x < y ? -1 : 1);
+  }
+  case Bool_kind:
+    return int(as<Bool>(a).value()) - int(as<Bool>(b).value());
+  case Int_kind:
+    return order_int(as<Int>(a).value(), as<Int>(b).value());
+  case Var_kind:
+    return order_var(as<Var>(a), as<Var>(b));
+  case Linear_kind: {
+    const Linear& x = as<Linear>(a);
+    const Linear& y = as<Linear>(b);
+    if (x.size() != y.size())
+      return x.size() < y.size() ? -1 : 1;
+    for (std::size_t i = 0; i < x.size(); ++i) {
+      if (int c = order_var(x.var(i), y.var(i)))
+        return c;
+      if (int c = order_int(x.coeff(i), y.coeff(i)))
+        return c;
+    }
+    return order_int(x.constant(), y.constant());
+  }
+  case Bind_kind:
+    return order_type(as<Bind>(a).type(), as<Bind>(b).type());
+  case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+    return order_type(as<Type>(a), as<Type>(b));
+  default:
+    if (arity(a) != arity(b))
+      return arity(a) < arity(b) ? -1 : 1;
+    return 0;
+  }
 }
 
 } // namespace
 
+// Expressions are ordered by kind, and then by their operands in
+// preorder, which are taken from a worklist as in same().
+int
+order(const Expr& a, const Expr& b) {
+  std::vector<Expr_pair> work {{&a, &b}};
+  while (not work.empty()) {
+    const Expr& x = *work.back().first;
+    const Expr& y = *work.back().second;
+    work.pop_back();
+    if (&x == &y)
+      continue;
+    if (kind(x) != kind(y))
+      return kind(x) < kind(y) ? -1 : 1;
+    if (int c = order_whole(x, y))
+      return c;
+    for (std::size_t i = arity(x); i-- > 0; )
+      work.emplace_back(&operand(x, i), &operand(y, i));
+  }
+  return 0;
+}
+
+// Equality is a conjunction over pairs of operands, so rather than a
+// traversal, pairs are taken from a worklist until one differs. Since
+// leaves are compared in place, the worklist is only allocated for
+// expressions nested more than one level deep.
 bool
 same(const Expr& a, const Expr& b) {
-  if (kind(a) != kind(b))
+  if (not compare_operands(a, b))
+    return same_whole(a, b);
+  std::vector<Expr_pair> work;
+  if (not same_operands(a, b, work))
     return false;
-  return same_expr(a, b);
+  while (not work.empty()) {
+    Expr_pair p = work.back();
+    work.pop_back();
+    if (not same_operands(*p.first, *p.second, work))
+      return false;
+  }
+  return true;
 }
 
 
@@ -221,6 +658,9 @@ Expr::Visitor::visit(const Neg& e) { visit_expr(e); }
 void
 Expr::Visitor::visit(const Pos& e) { visit_expr(e); }
 
+void
+Expr::Visitor::visit(const Linear& e) { visit_expr(e); }
+
 void
 Expr::Visitor::visit(const Eq& e) { visit_expr(e); }
 
@@ -278,118 +718,584 @@ Expr::Visitor::visit(const Kind_type& t) { visit_type(t); }
 // -------------------------------------------------------------------------- //
 // Factory
 
+// The cons table maps the kind and operands of each unique expression
+// to that expression. The kind of an expression is identified by the
+// factory that stores it. Integer literals are keyed by the value in
+// their node, and n-ary expressions and linear terms by hash. Keys are
+// logged in the order they are added so that entries can be removed when
+// a checkpoint is released.
+struct Expr::Factory::Cons_table {
+  struct Key {
+    const void* kind;
+    const void* first;
+    const void* second;
+
+    bool operator==(const Key& k) const {
+      return kind == k.kind and first == k.first and second == k.second;
+    }
+  };
+
+  struct Hash {
+    std::size_t operator()(const Key& k) const {
+      std::hash<const void*> h;
+      std::size_t x = h(k.kind);
+      x = x * 31 + h(k.first);
+      x = x * 31 + h(k.second);
+      return x;
+    }
+  };
+
+  struct Value_hash {
+    std::size_t operator()(const Integer* n) const { return hash(*n); }
+  };
+
+  struct Value_eq {
+    bool operator()(const Integer* a, const Integer* b) const {
+      return *a == *b;
+    }
+  };
+
+  std::unordered_map<Key, Expr*, Hash> nodes;
+  std::unordered_map<const Integer*, Int*, Value_hash, Value_eq> ints;
+  std::unordered_multimap<std::size_t, Expr*> hashed;
+  std::vector<Key> node_log;
+  std::vector<const Int*> int_log;
+  std::vector<const Expr*> hashed_log;
+};
+
+namespace {
+
+// Mixes x into h. Every bit of the result depends on every bit of the
+// inputs, so small operands such as kinds and bools spread well.
+inline std::size_t
+combine(std::size_t h, std::size_t x) {
+  std::uint64_t z = (h ^ x) * 0x9e3779b97f4a7c15ull + h;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+// Combines h with the hashes of the operands of e, a T.
+template<typename T>
+  std::size_t
+  combine_operands(std::size_t h, const Expr& e) {
+    const T& x = as<T>(e);
+    return combine(combine(h, hash(x.first())), hash(x.second()));
+  }
+
+// Combines h with the hashes of a list of operands.
+inline std::size_t
+combine_operands(std::size_t h, const Nary::Operands& es) {
+  for (const Expr* e : es)
+    h = combine(h, hash(*e));
+  return h;
+}
+
+// Combines h with the hashes of the terms of a linear term.
+inline std::size_t
+combine_terms(std::size_t h, const Linear::Vars& vs, const Linear::Coeffs& cs,
+              const Integer& c) {
+  for (std::size_t i = 0; i < vs.size(); ++i)
+    h = combine(combine(h, hash(*vs[i])), hash(cs[i]));
+  return combine(h, hash(c));
+}
+
+// Combines h with the hash of the variable v: its index and type when it
+// is bound, and otherwise its name rather than its declaration.
+inline std::size_t
+combine_var(std::size_t h, const Var& v) {
+  if (v.bound())
+    return combine(combine(h, v.index()), hash(v.type()));
+  return combine(h, hash(v.name()));
+}
+
+// Returns the structural hash of e from the hashes of its operands. This
+// is consistent with same(): a binding is hashed by its type alone, and
+// a type by its kind alone.
+std::size_t
+structural_hash(const Expr& e) {
+  std::size_t h = combine(0, e.tag);
+  switch (e.tag) {
+  case Id_kind: return combine(h, as<Id>(e).str().hash());
+  case Bool_kind: return combine(h, as<Bool>(e).value());
+  case Int_kind: return combine(h, hash(as<Int>(e).value()));
+  case Var_kind: return combine_var(h, as<Var>(e));
+  case Mul_kind: return combine_operands<Mul>(h, e);
+  case Div_kind: return combine_operands<Div>(h, e);
+  case Neg_kind: case Pos_kind: case Not_kind:
+    return combine(h, hash(as<Unary>(e).arg()));
+  case Linear_kind: {
+    const Linear& l = as<Linear>(e);
+    return combine_terms(h, l.vars, l.coeffs, l.constant());
+  }
+  case And_kind: case Or_kind:
+    return combine_operands(h, as<Nary>(e).operands());
+  case Bind_kind: return combine(h, hash(as<Bind>(e).type()));
+  case Exists_kind: return combine_operands<Exists>(h, e);
+  case Forall_kind: return combine_operands<Forall>(h, e);
+  case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+    return h;
+  default: return combine_operands<Binary>(h, e);
+  }
+}
+
+// Sets the hash of e, made by f, returning e.
+template<typename T>
+  inline T&
+  hashed(const Expr::Factory& f, T& e) {
+    e.hash_code = structural_hash(e) & f.hash_mask;
+    return e;
+  }
+
+// Returns the expression made by f with the given operands. When f is
+// hash-consing, the key (x, y) identifies the expression among those
+// made by the factory fac.
+template<typename T, typename... Args>
+  T&
+  cons(Expr::Factory& f, Basic_factory<T>& fac, const void* x, const void* y,
+       Args&&... args) {
+    if (not f.hash_consing())
+      return hashed(f, fac.make(std::forward<Args>(args)...));
+    Expr::Factory::Cons_table::Key k {&fac, x, y};
+    auto i = f.conses->nodes.find(k);
+    if (i != f.conses->nodes.end())
+      return static_cast<T&>(*i->second);
+    T& e = hashed(f, fac.make(std::forward<Args>(args)...));
+    e.table = f.conses.get();
+    f.conses->nodes.emplace(k, &e);
+    f.conses->node_log.push_back(k);
+    return e;
+  }
+
+// Returns the canonical operands of an expression of kind k with the
+// operands es. Operands of kind k are replaced by their own operands,
+// which are already canonical. The result is sorted by hash, and
+// operands with the same hash by order(), so that duplicates are
+// adjacent.
+Nary::Operands
+canonical_operands(Expr_kind k, const Nary::Operands& es) {
+  Nary::Operands r;
+  r.reserve(es.size());
+  for (const Expr* e : es) {
+    if (e->tag == k) {
+      const Nary& n = as<Nary>(*e);
+      r.insert(r.end(), n.begin(), n.end());
+    } else {
+      r.push_back(e);
+    }
+  }
+  std::stable_sort(r.begin(), r.end(), [](const Expr* a, const Expr* b) {
+    if (hash(*a) != hash(*b))
+      return hash(*a) < hash(*b);
+    return order(*a, *b) < 0;
+  });
+
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < r.size(); ++i)
+    if (not n or not same(*r[n - 1], *r[i]))
+      r[n++] = r[i];
+  r.resize(n);
+  return r;
+}
+
+// Returns the n-ary expression made by f with the operands es, in the
+// canonical form described by Expr::Factory. The unit is the value of
+// the expression when it has no operands.
+template<typename T>
+  const Expr&
+  make_nary(Expr::Factory& f, Basic_factory<T>& fac, Nary::Operands es,
+            bool unit) {
+    const Expr_kind k = Expr_kind_of<T>::value;
+    es = canonical_operands(k, es);
+    if (es.empty())
+      return f.make_bool(unit);
+    if (es.size() == 1)
+      return *es[0];
+
+    std::size_t h = combine_operands(combine(0, k), es) & f.hash_mask;
+    if (not f.hash_consing()) {
+      T& e = fac.make(std::move(es));
+      e.hash_code = h;
+      return e;
+    }
+    auto r = f.conses->hashed.equal_range(h);
+    for (auto i = r.first; i != r.second; ++i)
+      if (i->second->tag == k and as<Nary>(*i->second).operands() == es)
+        return *i->second;
+    T& e = fac.make(std::move(es));
+    e.hash_code = h;
+    e.table = f.conses.get();
+    f.conses->hashed.emplace(h, &e);
+    f.conses->hashed_log.push_back(&e);
+    return e;
+  }
+
+// Returns true when v precedes w in the canonical order of variables.
+inline bool
+var_less(const Var* v, const Var* w) { return order_var(*v, *w) < 0; }
+
+// Returns a copy of n whose limbs, if any, are allocated from the arena.
+Integer
+arena_copy(Integer_arena& a, const Integer& n) {
+  Integer_arena_scope scope(a);
+  return n;
+}
+
+// Calls op with every expression and declaration factory of f, in
+// declaration order, returning its result. The list is repeated in the
+// return type, so that the two cannot differ without the count below
+// failing to compile.
+template<typename Fac, typename Op>
+  auto
+  with_factories(Fac& f, Op op)
+    -> decltype(op(f.ids, f.bools, f.ints, f.vars,
+                   f.adds, f.subs, f.muls, f.divs, f.negs, f.poss, f.lins,
+                   f.eqs, f.nes, f.lts, f.gts, f.les, f.ges,
+                   f.ands, f.ors, f.imps, f.iffs, f.nots,
+                   f.binds, f.exs, f.fas,
+                   f.decls, f.defs)) {
+    return op(f.ids, f.bools, f.ints, f.vars,
+              f.adds, f.subs, f.muls, f.divs, f.negs, f.poss, f.lins,
+              f.eqs, f.nes, f.lts, f.gts, f.les, f.ges,
+              f.ands, f.ors, f.imps, f.iffs, f.nots,
+              f.binds, f.exs, f.fas,
+              f.decls, f.defs);
+  }
+
+// Calls fn on each of its arguments, in order.
+template<typename F>
+  struct Each_factory {
+    template<typename... Fs>
+      void operator()(Fs&... fs) {
+        int in_order[] = {(fn(fs), 0)...};
+        (void)in_order;
+      }
+
+    F fn;
+  };
+
+// Calls fn on each expression and declaration factory of f, in
+// declaration order.
+template<typename Fac, typename F>
+  void
+  each_factory(Fac& f, F fn) {
+    with_factories(f, Each_factory<F>{fn});
+  }
+
+// Counts the factories, as a type.
+struct Count_factories {
+  template<typename... Fs>
+    std::integral_constant<int, sizeof...(Fs)>
+    operator()(Fs&...) { return {}; }
+};
+
+using Factory_count =
+  decltype(with_factories(std::declval<Expr::Factory&>(), Count_factories()));
+
+static_assert(Factory_count::value == Expr::Factory::Checkpoint::factories,
+              "a checkpoint must hold a mark for every factory");
+
+struct Mark_factory {
+  template<typename T>
+    void operator()(const Basic_factory<T>& f) { *mark++ = f.mark(); }
+
+  Factory_mark* mark;
+};
+
+struct Release_factory {
+  template<typename T>
+    void operator()(Basic_factory<T>& f) { f.release(*mark++); }
+
+  const Factory_mark* mark;
+};
+
+struct Measure_factory {
+  template<typename T>
+    void operator()(const Basic_factory<T>& f) { *bytes += f.capacity(); }
+
+  std::size_t* bytes;
+};
+
+} // namespace
+
+Expr::Factory::Factory()
+  : Factory(false) { }
+
+Expr::Factory::Factory(bool use_arena, bool hash_cons, std::size_t mask)
+  : limbs(use_arena ? new Integer_arena() : nullptr)
+  , conses(hash_cons ? new Cons_table() : nullptr)
+  , hash_mask(mask)
+{
+  hashed(*this, bool_type);
+  hashed(*this, int_type);
+  hashed(*this, kind_type);
+}
+
+Expr::Factory::~Factory() { }
+
+Expr::Factory::Checkpoint
+Expr::Factory::mark() const {
+  Checkpoint c;
+  each_factory(*this, Mark_factory {c.marks});
+  c.conses = conses ? conses->node_log.size() : 0;
+  c.ints = conses ? conses->int_log.size() : 0;
+  c.hashed = conses ? conses->hashed_log.size() : 0;
+  return c;
+}
+
+std::size_t
+Expr::Factory::capacity() const {
+  std::size_t n = 0;
+  each_factory(*this, Measure_factory {&n});
+  return n;
+}
+
+// Cons table entries for released expressions are removed first, since
+// integer keys are found through the expressions.
+void
+Expr::Factory::release(const Checkpoint& c) {
+  if (conses) {
+    while (conses->node_log.size() > c.conses) {
+      conses->nodes.erase(conses->node_log.back());
+      conses->node_log.pop_back();
+    }
+    while (conses->int_log.size() > c.ints) {
+      conses->ints.erase(&conses->int_log.back()->value());
+      conses->int_log.pop_back();
+    }
+    while (conses->hashed_log.size() > c.hashed) {
+      const Expr* e = conses->hashed_log.back();
+      auto r = conses->hashed.equal_range(hash(*e));
+      for (auto i = r.first; i != r.second; ++i)
+        if (i->second == e) {
+          conses->hashed.erase(i);
+          break;
+        }
+      conses->hashed_log.pop_back();
+    }
+  }
+  each_factory(*this, Release_factory {c.marks});
+}
+
 Id&
-Expr::Factory::make_id(String s) { return ids.make(s); }
+Expr::Factory::make_id(String s) {
+  return cons(*this, ids, s.ptr(), nullptr, s);
+}
 
 Bool&
-Expr::Factory::make_bool(bool b) { return bools.make(b); }
+Expr::Factory::make_bool(bool b) {
+  return cons(*this, bools, b ? this : nullptr, nullptr, b);
+}
 
+// When the factory has a limb arena, the value of an integer literal is
+// copied into it. The arena is used only during that copy, so no other
+// integer on the thread takes its limbs.
 Int&
-Expr::Factory::make_int(Integer n) { return ints.make(n); }
+Expr::Factory::make_int(Integer n) {
+  if (not hash_consing())
+    return hashed(*this, ints.make(limbs ? arena_copy(*limbs, n)
+                                         : std::move(n)));
+  auto i = conses->ints.find(&n);
+  if (i != conses->ints.end())
+    return *i->second;
+  Int& e = hashed(*this, ints.make(limbs ? arena_copy(*limbs, n)
+                                         : std::move(n)));
+  e.table = conses.get();
+  conses->ints.emplace(&e.value(), &e);
+  conses->int_log.push_back(&e);
+  return e;
+}
 
+// A bound variable is keyed by its type and index, so it keeps the name
+// and declaration it was first made with.
 Var&
-Expr::Factory::make_var(const Id& n, const Decl& d) {
-  return vars.make(n, d);
+Expr::Factory::make_var(const Id& n, const Decl& d, std::size_t k) {
+  if (k == Var::unbound)
+    return cons(*this, vars, &n, &d, n, d);
+  const void* ix = reinterpret_cast<const void*>(k);
+  return cons(*this, vars, &d.type, ix, n, d, k);
 }
 
 Add&
 Expr::Factory::make_add(const Expr& l, const Expr& r) {
-  return adds.make(l, r);
+  return cons(*this, adds, &l, &r, l, r);
 }
 
 Sub&
 Expr::Factory::make_sub(const Expr& l, const Expr& r) {
-  return subs.make(l, r);
+  return cons(*this, subs, &l, &r, l, r);
 }
 
 Mul&
 Expr::Factory::make_mul(const Int& n, const Expr& e) {
-  return muls.make(n, e);
+  return cons(*this, muls, &n, &e, n, e);
 }
 
 Div&
 Expr::Factory::make_div(const Int& n, const Expr& e) {
-  return divs.make(n, e);
+  return cons(*this, divs, &n, &e, n, e);
 }
 
 Neg&
 Expr::Factory::make_neg(const Expr& e) {
-  return negs.make(e);
+  return cons(*this, negs, &e, nullptr, e);
 }
 
 Pos&
 Expr::Factory::make_pos(const Expr& e) {
-  return poss.make(e);
+  return cons(*this, poss, &e, nullptr, e);
+}
+
+// The terms are sorted through a permutation so that each coefficient
+// follows its variable.
+void
+sort_terms(Linear::Vars& vs, Linear::Coeffs& cs) {
+  assert(vs.size() == cs.size());
+  std::vector<std::size_t> order(vs.size());
+  for (std::size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+                   [&vs](std::size_t i, std::size_t j) {
+                     return var_less(vs[i], vs[j]);
+                   });
+
+  Linear::Vars v;
+  Linear::Coeffs c;
+  v.reserve(vs.size());
+  c.reserve(cs.size());
+  for (std::size_t i : order) {
+    if (not v.empty() and same_var(*v.back(), *vs[i])) {
+      c.back() += cs[i];
+    } else {
+      v.push_back(vs[i]);
+      c.push_back(std::move(cs[i]));
+    }
+  }
+
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < v.size(); ++i) {
+    if (c[i] != Integer(0)) {
+      v[n] = v[i];
+      c[n] = std::move(c[i]);
+      ++n;
+    }
+  }
+  v.resize(n);
+  c.resize(n);
+  vs = std::move(v);
+  cs = std::move(c);
+}
+
+// Linear terms are consed by hash, and their variables compared as by
+// same().
+const Linear&
+Expr::Factory::make_linear(Linear::Vars vs, Linear::Coeffs cs, Integer c) {
+  sort_terms(vs, cs);
+  std::size_t h = combine_terms(combine(0, Linear_kind), vs, cs, c) & hash_mask;
+  if (hash_consing()) {
+    auto r = conses->hashed.equal_range(h);
+    for (auto i = r.first; i != r.second; ++i) {
+      if (i->second->tag != Linear_kind)
+        continue;
+      Linear& l = as<Linear>(*i->second);
+      if (l.vars.size() == vs.size() and l.coeffs == cs and l.cst == c and
+          std::equal(vs.begin(), vs.end(), l.vars.begin(),
+                     [](const Var* v, const Var* w) {
+                       return same_var(*v, *w);
+                     }))
+        return l;
+    }
+  }
+  Linear& e = lins.make(std::move(vs), std::move(cs), std::move(c));
+  e.hash_code = h;
+  if (hash_consing()) {
+    e.table = conses.get();
+    conses->hashed.emplace(h, &e);
+    conses->hashed_log.push_back(&e);
+  }
+  return e;
 }
 
 Eq&
 Expr::Factory::make_eq(const Expr& l, const Expr& r) {
-  return eqs.make(l, r);
+  return cons(*this, eqs, &l, &r, l, r);
 }
 
 Ne&
 Expr::Factory::make_ne(const Expr& l, const Expr& r) {
-  return nes.make(l, r);
+  return cons(*this, nes, &l, &r, l, r);
 }
 
 Lt&
 Expr::Factory::make_lt(const Expr& l, const Expr& r) {
-  return lts.make(l, r);
+  return cons(*this, lts, &l, &r, l, r);
 }
 
 Gt&
 Expr::Factory::make_gt(const Expr& l, const Expr& r) {
-  return gts.make(l, r);
+  return cons(*this, gts, &l, &r, l, r);
 }
 
 Le&
 Expr::Factory::make_le(const Expr& l, const Expr& r) {
-  return les.make(l, r);
+  return cons(*this, les, &l, &r, l, r);
 }
 
 Ge&
 Expr::Factory::make_ge(const Expr& l, const Expr& r) {
-  return ges.make(l, r);
+  return cons(*this, ges, &l, &r, l, r);
 }
 
-And&
+const Expr&
 Expr::Factory::make_and(const Expr& l, const Expr& r) {
-  return ands.make(l, r);
+  return make_and({&l, &r});
+}
+
+const Expr&
+Expr::Factory::make_and(Nary::Operands es) {
+  return make_nary(*this, ands, std::move(es), true);
 }
 
-Or&
+const Expr&
 Expr::Factory::make_or(const Expr& l, const Expr& r) {
-  return ors.make(l, r);
+  return make_or({&l, &r});
+}
+
+const Expr&
+Expr::Factory::make_or(Nary::Operands es) {
+  return make_nary(*this, ors, std::move(es), false);
 }
 
 Imp&
 Expr::Factory::make_imp(const Expr& l, const Expr& r) {
-  return imps.make(l, r);
+  return cons(*this, imps, &l, &r, l, r);
 }
 
 Iff&
 Expr::Factory::make_iff(const Expr& l, const Expr& r) {
-  return iffs.make(l, r);
+  return cons(*this, iffs, &l, &r, l, r);
 }
 
 Not&
 Expr::Factory::make_not(const Expr& e) {
-  return nots.make(e);
+  return cons(*this, nots, &e, nullptr, e);
 }
 
 Bind&
 Expr::Factory::make_bind(const Id& n, const Type& t) {
-  return binds.make(n, t);
+  return cons(*this, binds, &n, &t, n, t);
 }
 
+// Quantifiers are keyed by the type of their binding rather than the
+// binding itself, which has a name.
 Exists&
 Expr::Factory::make_exists(const Bind& b, const Expr& e) {
-  return exs.make(b, e);
+  return cons(*this, exs, &b.type(), &e, b, e);
 }
 
 Forall&
 Expr::Factory::make_forall(const Bind& b, const Expr& e) {
-  return fas.make(b, e);
+  return cons(*this, fas, &b.type(), &e, b, e);
 }
 
 Bool_type&
@@ -404,8 +1310,9 @@ Expr::Factory::make_kind_type() { return kind_type; }
 // -------------------------------------------------------------------------- //
 // Context
 
-Context::Context()
-  : bool_type(make_bool_type())
+Context::Context(bool use_arena, bool hash_cons)
+  : Expr::Factory(use_arena, hash_cons)
+  , bool_type(make_bool_type())
   , int_type(make_int_type())
   , kind_type(make_kind_type())
   , top()
@@ -419,5 +1326,21 @@ Context::~Context() {
   pop();
 }
 
+// Add n : t to the current binding environment.
+const Decl&
+Context::declare(const Id& n, const Type& t) {
+  Decl& d = decls.make(n, t);
+  bind(d);
+  return d;
+}
+
+// Add n : t -> e to the current binding environment.
+const Def&
+Context::define(const Id& n, const Type& t, const Expr& e) {
+  Def& d = defs.make(n, t, e);
+  bind(d);
+  return d;
+}
+
 
 } // namespace sarah
@@ -2,12 +2,15 @@
 #ifndef SARAH_LANGUAGE_HPP
 #define SARAH_LANGUAGE_HPP
 
-#include <map>
+#include <cassert>
+#include <cstdint>
+#include <unordered_map>
 #include <stack>
 #include <vector>
 
 #include <utility/String.hpp>
 #include <utility/Integer.hpp>
+#include <utility/Memory.hpp>
 #include <utility/Structure.hpp>
 
 namespace sarah {
@@ -16,12 +19,14 @@ struct Expr;
 struct Id;
 struct Bool;
 struct Int;
+struct Var;
 struct Add;
 struct Sub;
 struct Mul;
 struct Div;
 struct Neg;
 struct Pos;
+struct Linear;
 struct Eq;
 struct Ne;
 struct Lt;
@@ -33,6 +38,7 @@ struct Or;
 struct Imp;
 struct Iff;
 struct Not;
+struct Bind;
 struct Exists;
 struct Forall;
 
@@ -45,6 +51,93 @@ struct Kind_type;
 // Misc.
 struct Context;
 
+// -------------------------------------------------------------------------- //
+// Expression kinds
+
+// Each class of expression has a distinct kind. The kind is stored in
+// every expression so that its class can be tested without dynamic_cast.
+enum Expr_kind : unsigned char {
+  Id_kind,
+  Bool_kind,
+  Int_kind,
+  Var_kind,
+
+  // Arithmetic expressions
+  Add_kind,
+  Sub_kind,
+  Mul_kind,
+  Div_kind,
+  Neg_kind,
+  Pos_kind,
+  Linear_kind,
+
+  // Relational expressions
+  Eq_kind,
+  Ne_kind,
+  Lt_kind,
+  Gt_kind,
+  Le_kind,
+  Ge_kind,
+
+  // Logical expressions
+  And_kind,
+  Or_kind,
+  Imp_kind,
+  Iff_kind,
+  Not_kind,
+
+  // Binding and quantifiers
+  Bind_kind,
+  Exists_kind,
+  Forall_kind,
+
+  // Types
+  Bool_type_kind,
+  Int_type_kind,
+  Kind_type_kind,
+};
+
+// The kind of each expression class.
+template<typename T>
+  struct Expr_kind_of;
+
+template<Expr_kind K>
+  struct Expr_kind_constant {
+    static constexpr Expr_kind value = K;
+  };
+
+template<> struct Expr_kind_of<Id> : Expr_kind_constant<Id_kind> { };
+template<> struct Expr_kind_of<Bool> : Expr_kind_constant<Bool_kind> { };
+template<> struct Expr_kind_of<Int> : Expr_kind_constant<Int_kind> { };
+template<> struct Expr_kind_of<Var> : Expr_kind_constant<Var_kind> { };
+template<> struct Expr_kind_of<Add> : Expr_kind_constant<Add_kind> { };
+template<> struct Expr_kind_of<Sub> : Expr_kind_constant<Sub_kind> { };
+template<> struct Expr_kind_of<Mul> : Expr_kind_constant<Mul_kind> { };
+template<> struct Expr_kind_of<Div> : Expr_kind_constant<Div_kind> { };
+template<> struct Expr_kind_of<Neg> : Expr_kind_constant<Neg_kind> { };
+template<> struct Expr_kind_of<Pos> : Expr_kind_constant<Pos_kind> { };
+template<> struct Expr_kind_of<Linear> : Expr_kind_constant<Linear_kind> { };
+template<> struct Expr_kind_of<Eq> : Expr_kind_constant<Eq_kind> { };
+template<> struct Expr_kind_of<Ne> : Expr_kind_constant<Ne_kind> { };
+template<> struct Expr_kind_of<Lt> : Expr_kind_constant<Lt_kind> { };
+template<> struct Expr_kind_of<Gt> : Expr_kind_constant<Gt_kind> { };
+template<> struct Expr_kind_of<Le> : Expr_kind_constant<Le_kind> { };
+template<> struct Expr_kind_of<Ge> : Expr_kind_constant<Ge_kind> { };
+template<> struct Expr_kind_of<And> : Expr_kind_constant<And_kind> { };
+template<> struct Expr_kind_of<Or> : Expr_kind_constant<Or_kind> { };
+template<> struct Expr_kind_of<Imp> : Expr_kind_constant<Imp_kind> { };
+template<> struct Expr_kind_of<Iff> : Expr_kind_constant<Iff_kind> { };
+template<> struct Expr_kind_of<Not> : Expr_kind_constant<Not_kind> { };
+template<> struct Expr_kind_of<Bind> : Expr_kind_constant<Bind_kind> { };
+template<> struct Expr_kind_of<Exists> : Expr_kind_constant<Exists_kind> { };
+template<> struct Expr_kind_of<Forall> : Expr_kind_constant<Forall_kind> { };
+template<> struct Expr_kind_of<Bool_type>
+  : Expr_kind_constant<Bool_type_kind> { };
+template<> struct Expr_kind_of<Int_type>
+  : Expr_kind_constant<Int_type_kind> { };
+template<> struct Expr_kind_of<Kind_type>
+  : Expr_kind_constant<Kind_type_kind> { };
+
 // -------------------------------------------------------------------------- //
 // Environment
 
@@ -67,41 +160,154 @@ struct Def : Decl {
   const Expr& init;
 };
 
-// An Environment is a mapping of identifiers (strings) to declarations.
+// An Environment maps names to declarations. It is an open-addressing
+// hash table with linear probing, keyed by the symbol ids of names. Small
+// environments, like the one made for each quantifier, are kept in the
+// environment object itself, so making one allocates nothing.
 //
-// TODO: Should the environment manage its own memory or use a factory.
-// It currently does, but we could also provide local factories for
-// Decls and Defs.
-struct Environment : std::map<String, Decl*> {
+// An environment does not own its declarations. They are made by the
+// context's expression factory, and live as long as the expressions made
+// with them.
+struct Environment {
+  Environment();
   ~Environment();
 
+  Environment(const Environment&) = delete;
+  Environment& operator=(const Environment&) = delete;
+
   // Binding interface
-  const Decl& declare(const Id&, const Type&);
-  const Def& define(const Id&, const Type&, const Expr&);
+  void bind(const Decl&);
 
   // Symbol lookup
   const Decl* lookup(String) const;
-  bool has_binding(String s) { return lookup(s); }
-  bool no_binding(String s)  { return not has_binding(s); }
+  bool has_binding(String s) const { return lookup(s); }
+  bool no_binding(String s) const { return not has_binding(s); }
+
+  // Returns the number of bindings in the environment.
+  std::size_t size() const { return count; }
+
+private:
+  // A slot is empty when its declaration is null.
+  struct Slot {
+    const Decl* decl;
+    std::uint32_t sym;
+  };
+
+  static constexpr std::size_t local_size = 4;
+
+  void grow();
+
+  Slot* slots;
+  std::size_t mask;  // The number of slots, minus 1
+  std::size_t count; // The number of bindings
+  Slot local[local_size];
 };
 
-// The stack is a stack of environments.
+// A persistent environment maps names to declarations, but is never
+// modified. Binding a name returns a new environment, which shares all
+// but a path of its nodes with the old one, so an environment can be
+// extended along several branches at once. Copying an environment takes
+// constant time, and copies may be used and extended on different
+// threads, since only their reference counts change.
+//
+// It is a hash array mapped trie over the symbol ids of names. Each
+// node branches on 5 bits of the id and stores only its occupied
+// entries, so binding and lookup visit at most 7 nodes.
+//
+// Like an environment, a persistent environment does not own its
+// declarations.
+struct Persistent_environment {
+  Persistent_environment()
+    : root(nullptr), count(0) { }
+
+  Persistent_environment(const Persistent_environment&);
+  Persistent_environment(Persistent_environment&&);
+  Persistent_environment& operator=(Persistent_environment);
+  ~Persistent_environment();
+
+  // Binding interface
+  //
+  // Returns this environment with d bound, which hides any declaration
+  // of the same name.
+  Persistent_environment bind(const Decl& d) const;
+
+  // Symbol lookup
+  const Decl* lookup(String) const;
+  bool has_binding(String s) const { return lookup(s); }
+  bool no_binding(String s) const { return not has_binding(s); }
+
+  // Returns the number of bindings in the environment.
+  std::size_t size() const { return count; }
+
+private:
+  struct Node;
+
+  Persistent_environment(const Node* n, std::size_t k)
+    : root(n), count(k) { }
+
+  const Node* root;
+  std::size_t count;
+};
+
+// The stack is a stack of environments. Declarations are bound through
+// the stack but made by the context, so a declaration outlives the
+// environment it was made in, and variables that refer to it remain
+// valid after its scope is popped.
+//
+// Names are resolved through a table indexed by symbol id that holds the
+// innermost declaration of each name, so lookup does not depend on the
+// depth of the stack. A declaration that shadows another saves the outer
+// one on a log, and popping an environment restores the declarations its
+// names shadowed. Environments are pushed empty, and bindings are made
+// through the stack.
+//
+// The stack also keeps a persistent environment of the visible
+// declarations, extended by each binding and restored by each pop, so a
+// snapshot of the stack is a copy of it.
+//
+// The level of an environment is its position in the stack, counting
+// from the bottom, so declarations in the outermost environment have
+// level 0.
 struct Stack : std::vector<Environment*> {
   using Base = std::vector<Environment*>;
 
   // Stack interface
   Environment& top() { return *Base::back(); }
-  void push(Environment& e) { Base::push_back(&e); }
-  void pop() { Base::pop_back(); }
+  void push(Environment& e);
+  void pop();
 
   // Binding interface
-  const Decl& declare(const Id&, const Type&);
-  const Def& define(const Id&, const Type&, const Expr&);
+  void bind(const Decl&);
 
   // Symbol lookup
   const Decl* lookup(String) const;
+  std::size_t level(String) const;
+
+  // Returns a persistent environment with the visible declarations. This
+  // takes constant time.
+  Persistent_environment snapshot() const { return current; }
   const bool has_binding(String s) const { return lookup(s); }
   const bool no_binding(String s) const { return not has_binding(s); }
+
+private:
+  // The innermost declaration of a name, and the level at which it was
+  // declared.
+  struct Visible {
+    const Decl* decl;
+    std::size_t level;
+  };
+
+  // A declaration that was shadowed by one in a later environment.
+  struct Shadow {
+    std::uint32_t sym;
+    Visible prev;
+  };
+
+  std::vector<Visible> visible; // Indexed by symbol id
+  std::vector<Shadow> shadows;
+  std::vector<std::size_t> marks;   // The size of shadows at each push
+  Persistent_environment current;   // The visible declarations
+  std::vector<Persistent_environment> saved; // current at each push
 };
 
 // -------------------------------------------------------------------------- //
@@ -116,14 +322,50 @@ struct Expr {
   struct Visitor;
   struct Factory;
 
+  Expr()
+    : hash_code(0), table(nullptr) { }
+
   virtual ~Expr() { }
 
   virtual void accept(Visitor&) const = 0;
+
+  // Every expression is an Expr.
+  static bool classof(const Expr&) { return true; }
+
+  // The kind of the expression, set by Expr_impl.
+  Expr_kind tag;
+
+  // The structural hash of the expression, set by the factory that
+  // made it.
+  std::size_t hash_code;
+
+  // The hash-consing table that made this expression, if any. Two
+  // expressions from the same table are the same only when they are
+  // the same object.
+  const void* table;
 };
 
 // Expression interface
 bool same(const Expr&, const Expr&);
 
+// Returns a negative number, zero or a positive number as a precedes, is
+// the same as, or follows b in a total order of expressions. Expressions
+// are ordered by the same properties that same() compares.
+int order(const Expr&, const Expr&);
+
+// Returns the structural hash of e. Expressions that are the same have
+// equal hashes.
+inline std::size_t hash(const Expr& e) { return e.hash_code; }
+
+// Returns the number of operands of e. The operands of an expression are
+// the expressions it holds: the name of a variable, the variables of a
+// linear term, the name and type of a binding, and so on. Literals and
+// types have none.
+std::size_t arity(const Expr& e);
+
+// Returns the ith operand of e.
+const Expr& operand(const Expr& e, std::size_t i);
+
 
 // A helper class for expr implementations. The B parameter indicates
 // the direct base of the implementing class, and D is the derived class.
@@ -131,9 +373,16 @@ template<typename D, typename B = Expr>
   struct Expr_impl : B {
     template<typename... Args>
       Expr_impl(Args&&... args)
-        : B(std::forward<Args>(args)...) { }
+        : B(std::forward<Args>(args)...) {
+        this->tag = Expr_kind_of<D>::value;
+      }
 
     virtual void accept(typename B::Visitor& v) const;
+
+    // Returns true when e is a D.
+    static bool classof(const Expr& e) {
+      return e.tag == Expr_kind_of<D>::value;
+    }
   };
 
 // An identifier denoting a binding.
@@ -148,7 +397,7 @@ struct Id : Atom<String>, Expr_impl<Id> {
 // An integer literal.
 struct Int : Atom<Integer>, Expr_impl<Int> {
   Int(Integer n)
-    : Atom<Integer>(n) { }
+    : Atom<Integer>(std::move(n)) { }
 
   const Integer& value() const { return first(); }
 };
@@ -161,13 +410,37 @@ struct Bool : Atom<bool>, Expr_impl<Bool> {
   bool value() const { return first(); }
 };
 
-// A named reference to a binding.
+// A named reference to a binding. A variable bound by a quantifier also
+// has a de Bruijn index: the number of quantifiers between it and its
+// binder. Bound variables are identified by their index and type rather
+// than by name, so alpha-equivalent formulas are the same. Variables
+// that are not bound, like the names of types, are identified by their
+// declaration.
+//
+// A hash-consing factory makes one node for all bound variables with the
+// same index and type, which keeps the name and declaration of the first
+// of them. The name() and decl() of a bound variable are then those of
+// some binder of its type, not necessarily its own, and must not be used
+// to identify it. Its binder, found by its index, has its name.
 struct Var : Structure<Id, Decl>, Expr_impl<Var> {
-  Var(const Id& n, const Decl& d)
-    : Structure<Id, Decl>(n, d) { }
+  static constexpr std::size_t unbound = std::size_t(-1);
+
+  Var(const Id& n, const Decl& d, std::size_t k = unbound)
+    : Structure<Id, Decl>(n, d), ix(k) { }
 
   const Id& name() const { return first(); }
   const Decl& decl() const { return second(); }
+
+  // Returns the type of the variable.
+  const Type& type() const { return decl().type; }
+
+  // Returns true when the variable is bound by a quantifier.
+  bool bound() const { return ix != unbound; }
+
+  // Returns the de Bruijn index of a bound variable.
+  std::size_t index() const { return ix; }
+
+  std::size_t ix;
 };
 
 // A base class for generic unary expressions.
@@ -176,6 +449,10 @@ struct Unary : Structure<Expr>, Expr {
     : Structure<Expr>(l) { }
 
   const Expr& arg() const { return first(); }
+
+  static bool classof(const Expr& e) {
+    return e.tag == Neg_kind or e.tag == Pos_kind or e.tag == Not_kind;
+  }
 };
 
 template<typename D>
@@ -188,11 +465,48 @@ struct Binary : Structure<Expr, Expr>, Expr {
 
   const Expr& left() const { return first(); }
   const Expr& right() const { return second(); }
+
+  static bool classof(const Expr& e) {
+    switch (e.tag) {
+    case Add_kind: case Sub_kind:
+    case Eq_kind: case Ne_kind: case Lt_kind:
+    case Gt_kind: case Le_kind: case Ge_kind:
+    case Imp_kind: case Iff_kind:
+      return true;
+    default:
+      return false;
+    }
+  }
 };
 
 template<typename D>
   using Binary_impl = Expr_impl<D, Binary>;
 
+// A base class for n-ary expressions. The factory keeps the operands in
+// a canonical order, so they are compared pairwise.
+struct Nary : Expr {
+  using Operands = std::vector<const Expr*>;
+
+  Nary(Operands es)
+    : ops(std::move(es)) { }
+
+  std::size_t size() const { return ops.size(); }
+  const Expr& operand(std::size_t i) const { return *ops[i]; }
+  const Operands& operands() const { return ops; }
+
+  Operands::const_iterator begin() const { return ops.begin(); }
+  Operands::const_iterator end() const { return ops.end(); }
+
+  static bool classof(const Expr& e) {
+    return e.tag == And_kind or e.tag == Or_kind;
+  }
+
+  Operands ops;
+};
+
+template<typename D>
+  using Nary_impl = Expr_impl<D, Nary>;
+
 
 // Addition, `e1 - e2`
 struct Add : Binary_impl<Add> {
@@ -230,6 +544,32 @@ struct Pos : Unary_impl<Pos> {
     : Unary_impl<Pos>(e) { }
 };
 
+// A linear term, `c1*x1 + ... + cn*xn + c`. The factory keeps the
+// variables sorted and distinct, and every coefficient non-zero. The
+// coefficients are stored apart from the variables so that they can
+// be given to the batch gcd functions.
+struct Linear : Expr_impl<Linear> {
+  using Vars = std::vector<const Var*>;
+  using Coeffs = std::vector<Integer>;
+
+  Linear(Vars vs, Coeffs cs, Integer c)
+    : vars(std::move(vs)), coeffs(std::move(cs)), cst(std::move(c)) { }
+
+  std::size_t size() const { return vars.size(); }
+  const Var& var(std::size_t i) const { return *vars[i]; }
+  const Integer& coeff(std::size_t i) const { return coeffs[i]; }
+  const Integer& constant() const { return cst; }
+
+  Vars vars;
+  Coeffs coeffs;
+  Integer cst;
+};
+
+// Sorts the variables of a linear term, together with their coefficients,
+// into the canonical order of the factory. Coefficients of the same
+// variable are added, and variables whose coefficient is 0 are removed.
+void sort_terms(Linear::Vars&, Linear::Coeffs&);
+
 // Equal.
 struct Eq : Binary_impl<Eq> {
   Eq(const Expr& l, const Expr& r)
@@ -266,16 +606,16 @@ struct Ge : Binary_impl<Ge> {
     : Binary_impl<Ge>(l, r) { }
 };
 
-// Logical and.
-struct And : Binary_impl<And> {
-  And(const Expr& l, const Expr& r)
-    : Binary_impl<And>(l, r) { }
+// Logical and, `e1 and e2 and ... and en`.
+struct And : Nary_impl<And> {
+  And(Operands es)
+    : Nary_impl<And>(std::move(es)) { }
 };
 
-// Logical or.
-struct Or : Binary_impl<Or> {
-  Or(const Expr& l, const Expr& r)
-    : Binary_impl<Or>(l, r) { }
+// Logical or, `e1 or e2 or ... or en`.
+struct Or : Nary_impl<Or> {
+  Or(Operands es)
+    : Nary_impl<Or>(std::move(es)) { }
 };
 
 // Implication.
@@ -296,7 +636,9 @@ struct Not : Unary_impl<Not> {
     : Unary_impl<Not>(e) { }
 };
 
-// A name/type binding of the form n : t.
+// A name/type binding of the form n : t. Bindings are compared by type
+// alone, since the name of a bound variable does not change the meaning
+// of its quantifier.
 struct Bind : Structure<Id, Type>, Expr_impl<Bind> {
   Bind(const Id& n, const Type& t)
     : Structure<Id, Type>(n, t) { }
@@ -327,7 +669,9 @@ struct Forall : Structure<Bind, Expr>, Expr_impl<Forall> {
 // -------------------------------------------------------------------------- //
 // Types
 
-struct Type : Expr { };
+struct Type : Expr {
+  static bool classof(const Expr& e) { return e.tag >= Bool_type_kind; }
+};
 
 template<typename D>
   using Type_impl = Expr_impl<D, Type>;
@@ -357,6 +701,7 @@ struct Expr::Visitor {
   virtual void visit(const Div&);
   virtual void visit(const Neg&);
   virtual void visit(const Pos&);
+  virtual void visit(const Linear&);
 
   virtual void visit(const Eq&);
   virtual void visit(const Ne&);
@@ -387,16 +732,117 @@ template<typename D, typename B>
     v.visit(static_cast<const D&>(*this));
   }
 
+// Calls f with e converted to its class, returning the result. The class
+// is found by switching on the kind of e rather than by double dispatch,
+// so f is an ordinary function object with an overload (or a template)
+// for each class of expression. Every overload has the same return type.
+template<typename F>
+  inline auto
+  visit(const Expr& e, F&& f) -> decltype(f(std::declval<const Id&>())) {
+    switch (e.tag) {
+    case Id_kind: return f(static_cast<const Id&>(e));
+    case Bool_kind: return f(static_cast<const Bool&>(e));
+    case Int_kind: return f(static_cast<const Int&>(e));
+    case Var_kind: return f(static_cast<const Var&>(e));
+    case Add_kind: return f(static_cast<const Add&>(e));
+    case Sub_kind: return f(static_cast<const Sub&>(e));
+    case Mul_kind: return f(static_cast<const Mul&>(e));
+    case Div_kind: return f(static_cast<const Div&>(e));
+    case Neg_kind: return f(static_cast<const Neg&>(e));
+    case Pos_kind: return f(static_cast<const Pos&>(e));
+    case Linear_kind: return f(static_cast<const Linear&>(e));
+    case Eq_kind: return f(static_cast<const Eq&>(e));
+    case Ne_kind: return f(static_cast<const Ne&>(e));
+    case Lt_kind: return f(static_cast<const Lt&>(e));
+    case Gt_kind: return f(static_cast<const Gt&>(e));
+    case Le_kind: return f(static_cast<const Le&>(e));
+    case Ge_kind: return f(static_cast<const Ge&>(e));
+    case And_kind: return f(static_cast<const And&>(e));
+    case Or_kind: return f(static_cast<const Or&>(e));
+    case Imp_kind: return f(static_cast<const Imp&>(e));
+    case Iff_kind: return f(static_cast<const Iff&>(e));
+    case Not_kind: return f(static_cast<const Not&>(e));
+    case Bind_kind: return f(static_cast<const Bind&>(e));
+    case Exists_kind: return f(static_cast<const Exists&>(e));
+    case Forall_kind: return f(static_cast<const Forall&>(e));
+    case Bool_type_kind: return f(static_cast<const Bool_type&>(e));
+    case Int_type_kind: return f(static_cast<const Int_type&>(e));
+    case Kind_type_kind: break;
+    }
+    assert(e.tag == Kind_type_kind);
+    return f(static_cast<const Kind_type&>(e));
+  }
+
 // -------------------------------------------------------------------------- //
 // Factory
 
-// Creates and stores expressions.
+// Creates and stores expressions. Each expression is given its structural
+// hash when it is made, computed from the hashes of its operands.
+//
+// When constructed with use_arena set, the factory owns an Integer_arena.
+// make_int copies the value of a large literal into the arena, which is
+// in use only during that copy, so other integers on the thread keep
+// their own limbs. The limbs of every literal are released with the
+// factory. The coefficients of linear terms, and temporaries, are not
+// copied into the arena and still allocate with malloc.
+//
+// When constructed with hash_cons set, the factory makes at most one
+// expression of each kind for a given list of operands: requests for an
+// existing expression return it instead of making a copy. Operands are
+// compared by identity, except that names are compared by spelling and
+// literals by value. Bound variables are made by index and type, and
+// quantifiers by the type of their binding and their body, so the first
+// of a set of alpha-equivalent formulas is returned for the rest, with
+// its names.
+//
+// Conjunctions and disjunctions are made in a canonical form: operands
+// of the same kind are flattened into their parent, and the operands are
+// sorted by hash and then by order(), with duplicates removed. When a
+// single operand remains, it is returned instead; when none do, the unit
+// (true or false) is.
+// Linear terms are likewise made with their variables in sorted order.
 struct Expr::Factory {
+  struct Cons_table;
+  struct Checkpoint;
+
+  Factory();
+  explicit Factory(bool use_arena, bool hash_cons = false,
+                   std::size_t hash_mask = std::size_t(-1));
+  ~Factory();
+
+  // Returns true when expressions are hash-consed.
+  bool hash_consing() const { return conses != nullptr; }
+
+  // Checkpoints
+  //
+  // Every expression made after a checkpoint is taken can be destroyed
+  // at once by releasing it. The caller guarantees that no remaining
+  // expression refers to a released one. Checkpoints must be released
+  // in the reverse order they were taken.
+  Checkpoint mark() const;
+  void release(const Checkpoint&);
+
+  // Returns the number of bytes reserved by the slabs of expressions and
+  // declarations.
+  std::size_t capacity() const;
+
+  // Storage for integer limbs. This is declared first so that it is
+  // destroyed after every expression.
+  std::unique_ptr<Integer_arena> limbs;
+
+  // The unique expressions, when hash-consing.
+  std::unique_ptr<Cons_table> conses;
+
+  // For testing: the mask applied to the hash of every expression the
+  // factory makes, so that a test can force collisions. All bits are set
+  // unless a mask is given when the factory is constructed.
+  const std::size_t hash_mask;
+
   // Atomic expressions
   Id& make_id(String);
   Bool& make_bool(bool);
   Int& make_int(Integer);
-  Var& make_var(const Id&, const Decl&);
+  Var& make_var(const Id&, const Decl&, std::size_t = Var::unbound);
 
   // Arithmetic expressions.
   Add& make_add(const Expr&, const Expr&);
@@ -405,6 +851,7 @@ struct Expr::Factory {
   Div& make_div(const Int&, const Expr&);
   Neg& make_neg(const Expr&);
   Pos& make_pos(const Expr&);
+  const Linear& make_linear(Linear::Vars, Linear::Coeffs, Integer);
 
   // Relational expressions
   Eq& make_eq(const Expr&, const Expr&);
@@ -415,8 +862,10 @@ struct Expr::Factory {
   Ge& make_ge(const Expr&, const Expr&);
 
   // Logical expressions
-  And& make_and(const Expr&, const Expr&);
-  Or& make_or(const Expr&, const Expr&);
+  const Expr& make_and(const Expr&, const Expr&);
+  const Expr& make_and(Nary::Operands);
+  const Expr& make_or(const Expr&, const Expr&);
+  const Expr& make_or(Nary::Operands);
   Imp& make_imp(const Expr&, const Expr&);
   Iff& make_iff(const Expr&, const Expr&);
   Not& make_not(const Expr&);
@@ -444,6 +893,7 @@ struct Expr::Factory {
   Basic_factory<Div> divs;
   Basic_factory<Neg> negs;
   Basic_factory<Pos> poss;
+  Basic_factory<Linear> lins;
   Basic_factory<Eq> eqs;
   Basic_factory<Ne> nes;
   Basic_factory<Lt> lts;
@@ -459,12 +909,57 @@ struct Expr::Factory {
   Basic_factory<Exists> exs;
   Basic_factory<Forall> fas;
 
+  // Declarations are released with the expressions that refer to them.
+  Basic_factory<Decl> decls;
+  Basic_factory<Def> defs;
+
   // We don't need factories for these.
   Bool_type bool_type;
   Int_type int_type;
   Kind_type kind_type;
 };
 
+// The state of each of a factory's expression factories, and the size of
+// its cons table. The number of factories is checked against the list
+// that marks them.
+struct Expr::Factory::Checkpoint {
+  static constexpr int factories = 27;
+
+  Factory_mark marks[factories];
+  std::size_t conses;
+  std::size_t ints;
+  std::size_t hashed;
+};
+
+// A Factory_scope releases the expressions made by a factory during its
+// lifetime, unless it is told to keep them. For example:
+//
+//    Factory_scope scope(f);
+//    if (const Expr* e = try_something(f)) {
+//      scope.keep();
+//      return e;
+//    }
+//    return nullptr; // Everything made by try_something is released.
+struct Factory_scope {
+  explicit Factory_scope(Expr::Factory& f)
+    : factory(f), mark(f.mark()), kept(false) { }
+
+  ~Factory_scope() {
+    if (not kept)
+      factory.release(mark);
+  }
+
+  Factory_scope(const Factory_scope&) = delete;
+  Factory_scope& operator=(const Factory_scope&) = delete;
+
+  // Keep the expressions made in this scope.
+  void keep() { kept = true; }
+
+  Expr::Factory& factory;
+  Expr::Factory::Checkpoint mark;
+  bool kept;
+};
+
 // -------------------------------------------------------------------------- //
 // Context
 
@@ -475,9 +970,17 @@ struct Expr::Factory {
 // context. We should have other contexts: elaboration context,
 // evaluation context, etc.
 struct Context : Stack, Expr::Factory {
-  Context();
+  explicit Context(bool use_arena = false, bool hash_cons = false);
   ~Context();
 
+  // Binding interface
+  //
+  // Declarations are made in the expression factory, so they are
+  // released by the Factory_scope that releases the variables that
+  // refer to them.
+  const Decl& declare(const Id&, const Type&);
+  const Def& define(const Id&, const Type&, const Expr&);
+
   // Type references
   const Bool_type& bool_type;
   const Int_type&  int_type;
@@ -492,4 +995,18 @@ struct Context : Stack, Expr::Factory {
 
 } // namespace sarah
 
+
+namespace std {
+
+// Hash support for Exprs.
+template<>
+struct hash<sarah::Expr> {
+  std::size_t
+  operator()(const sarah::Expr& e) const {
+    return sarah::hash(e);
+  }
+};
+
+} // namespace std
+
 #endif
@@ -0,0 +1,315 @@
+#include <cassert>
+#include <utility>
+#include <vector>
+
+#include <utility/Gcd.hpp>
+#include <utility/Traversal.hpp>
+#include <utility/Utility.hpp>
+
+#include "Normalize.hpp"
+
+namespace sarah {
+
+namespace {
+
+// A linear term under construction.
+struct Sum {
+  Linear::Vars vars;
+  Linear::Coeffs coeffs;
+  Integer cst;
+};
+
+inline Integer
+negate(const Integer& n) { return Integer(0) - n; }
+
+// Adds k times the arithmetic expression e to s. The terms are collected
+// from a worklist rather than by recursion, since sums can be deep.
+void
+collect(Sum& s, const Expr& e, const Integer& k) {
+  std::vector<std::pair<const Expr*, Integer>> work;
+  work.emplace_back(&e, k);
+  while (not work.empty()) {
+    const Expr& x = *work.back().first;
+    Integer c = std::move(work.back().second);
+    work.pop_back();
+    switch (x.tag) {
+    case Int_kind:
+      s.cst += c * as<Int>(x).value();
+      break;
+    case Var_kind:
+      s.vars.push_back(&as<Var>(x));
+      s.coeffs.push_back(c);
+      break;
+    case Add_kind: {
+      const Add& a = as<Add>(x);
+      work.emplace_back(&a.right(), c);
+      work.emplace_back(&a.left(), c);
+      break;
+    }
+    case Sub_kind: {
+      const Sub& a = as<Sub>(x);
+      work.emplace_back(&a.right(), negate(c));
+      work.emplace_back(&a.left(), c);
+      break;
+    }
+    case Mul_kind: {
+      const Mul& m = as<Mul>(x);
+      work.emplace_back(&m.second(), c * m.first().value());
+      break;
+    }
+    case Neg_kind:
+      work.emplace_back(&as<Neg>(x).arg(), negate(c));
+      break;
+    case Pos_kind:
+      work.emplace_back(&as<Pos>(x).arg(), c);
+      break;
+    case Linear_kind: {
+      const Linear& l = as<Linear>(x);
+      for (std::size_t i = 0; i < l.size(); ++i) {
+        s.vars.push_back(&l.var(i));
+        s.coeffs.push_back(c * l.coeff(i));
+      }
+      s.cst += c * l.constant();
+      break;
+    }
+    default:
+      assert(false && "not an arithmetic expression");
+    }
+  }
+}
+
+// Returns the sum of the terms of e.
+Sum
+sum(const Expr& e) {
+  Sum s;
+  collect(s, e, Integer(1));
+  sort_terms(s.vars, s.coeffs);
+  return s;
+}
+
+// Returns the sum of the terms of a - b.
+Sum
+difference(const Expr& a, const Expr& b) {
+  Sum s;
+  collect(s, a, Integer(1));
+  collect(s, b, Integer(-1));
+  sort_terms(s.vars, s.coeffs);
+  return s;
+}
+
+void
+negate(Sum& s) {
+  for (Integer& c : s.coeffs)
+    c = negate(c);
+  s.cst = negate(s.cst);
+}
+
+inline const Linear&
+make_linear(Expr::Factory& f, Sum& s) {
+  return f.make_linear(std::move(s.vars), std::move(s.coeffs),
+                       std::move(s.cst));
+}
+
+// Returns s == 0, or s != 0 when eq is false. The equation has no
+// solution when the gcd of the coefficients does not divide the constant.
+const Expr&
+normalize_equation(Expr::Factory& f, Sum s, bool eq) {
+  if (s.vars.empty())
+    return f.make_bool((s.cst == Integer(0)) == eq);
+  Integer g = divide_content(s.coeffs.data(), s.coeffs.size());
+  if (s.cst % g != Integer(0))
+    return f.make_bool(not eq);
+  s.cst /= g;
+  if (s.coeffs[0] < Integer(0))
+    negate(s);
+  const Linear& t = make_linear(f, s);
+  if (eq)
+    return f.make_eq(t, f.make_int(Integer(0)));
+  else
+    return f.make_ne(t, f.make_int(Integer(0)));
+}
+
+// Returns s <= 0. Dividing by the gcd g of the coefficients rounds the
+// constant up, since g*y + c <= 0 exactly when y + ceil(c/g) <= 0.
+const Expr&
+normalize_inequality(Expr::Factory& f, Sum s) {
+  if (s.vars.empty())
+    return f.make_bool(s.cst <= Integer(0));
+  Integer g = divide_content(s.coeffs.data(), s.coeffs.size());
+  s.cst = negate(negate(s.cst) / g);
+  return f.make_le(make_linear(f, s), f.make_int(Integer(0)));
+}
+
+// Returns n | s. The modulus, coefficients and constant are divided by
+// their common gcd, and the constant is reduced modulo the result. There
+// is no solution when the gcd of the modulus and the coefficients does
+// not divide the constant.
+const Expr&
+normalize_divisibility(Expr::Factory& f, const Integer& n, Sum s) {
+  if (n == Integer(0))
+    return normalize_equation(f, std::move(s), true);
+  Integer m = n < Integer(0) ? negate(n) : n;
+  if (s.vars.empty())
+    return f.make_bool(s.cst % m == Integer(0));
+
+  Integer g = gcd(gcd(s.coeffs.data(), s.coeffs.size()), m);
+  if (s.cst % g != Integer(0))
+    return f.make_bool(false);
+  g = gcd(g, s.cst);
+  if (g != Integer(1)) {
+    for (Integer& c : s.coeffs)
+      c /= g;
+    s.cst /= g;
+    m /= g;
+  }
+  if (m == Integer(1))
+    return f.make_bool(true);
+  if (s.coeffs[0] < Integer(0))
+    negate(s);
+  s.cst %= m;
+  return f.make_div(f.make_int(m), make_linear(f, s));
+}
+
+} // namespace
+
+const Linear&
+linearize(Expr::Factory& f, const Expr& e) {
+  Sum s = sum(e);
+  return make_linear(f, s);
+}
+
+namespace {
+
+// Returns the atom e in normal form. Relations are normalized by the
+// difference of their operands. Other atoms, such as boolean literals,
+// are unchanged.
+const Expr&
+normalize_atom(Expr::Factory& f, const Expr& e) {
+  switch (e.tag) {
+  case Eq_kind: {
+    const Eq& r = as<Eq>(e);
+    return normalize_equation(f, difference(r.left(), r.right()), true);
+  }
+  case Ne_kind: {
+    const Ne& r = as<Ne>(e);
+    return normalize_equation(f, difference(r.left(), r.right()), false);
+  }
+  case Lt_kind: {
+    // a < b is a - b + 1 <= 0.
+    const Lt& r = as<Lt>(e);
+    Sum s = difference(r.left(), r.right());
+    s.cst += Integer(1);
+    return normalize_inequality(f, std::move(s));
+  }
+  case Gt_kind: {
+    const Gt& r = as<Gt>(e);
+    Sum s = difference(r.right(), r.left());
+    s.cst += Integer(1);
+    return normalize_inequality(f, std::move(s));
+  }
+  case Le_kind: {
+    const Le& r = as<Le>(e);
+    return normalize_inequality(f, difference(r.left(), r.right()));
+  }
+  case Ge_kind: {
+    const Ge& r = as<Ge>(e);
+    return normalize_inequality(f, difference(r.right(), r.left()));
+  }
+  case Div_kind: {
+    const Div& d = as<Div>(e);
+    return normalize_divisibility(f, d.first().value(), sum(d.second()));
+  }
+  default:
+    return e;
+  }
+}
+
+// Returns the unit of a conjunction or disjunction.
+inline bool
+unit(const Expr& e) { return e.tag == And_kind; }
+
+// Returns true when the normalized operand x decides the conjunction or
+// disjunction e.
+inline bool
+decides(const Expr& e, const Expr& x) {
+  const Bool* b = as<Bool>(&x);
+  return b and b->value() != unit(e);
+}
+
+// Rebuilds formulas around their normalized atoms, after their operands.
+struct Normalize_walker : Walker<const Expr*, const Expr*> {
+  Normalize_walker(Expr::Factory& f)
+    : fac(f) { }
+
+  // The binding of a quantifier is not normalized.
+  void enter(const Expr* e, std::vector<const Expr*>& es) {
+    switch (e->tag) {
+    case And_kind: case Or_kind:
+    case Imp_kind: case Iff_kind: case Not_kind:
+      for (std::size_t i = 0; i < arity(*e); ++i)
+        es.push_back(&operand(*e, i));
+      return;
+    case Exists_kind: case Forall_kind:
+      es.push_back(&operand(*e, 1));
+      return;
+    default:
+      return;
+    }
+  }
+
+  // Atoms may be evaluated, so a conjunction or disjunction is decided by
+  // any operand that is not its unit.
+  bool next(const Expr* e, std::size_t i, const Expr* const* rs) {
+    if (i != 0 and is<Nary>(*e))
+      return not decides(*e, *rs[i - 1]);
+    return true;
+  }
+
+  const Expr* leave(const Expr* e, const Expr** rs, std::size_t n) {
+    switch (e->tag) {
+    case And_kind: case Or_kind:
+      return &connective(*e, rs, n);
+    case Imp_kind:
+      return &fac.make_imp(*rs[0], *rs[1]);
+    case Iff_kind:
+      return &fac.make_iff(*rs[0], *rs[1]);
+    case Not_kind:
+      return &fac.make_not(*rs[0]);
+    case Exists_kind:
+      return &fac.make_exists(as<Exists>(*e).binding(), *rs[0]);
+    case Forall_kind:
+      return &fac.make_forall(as<Forall>(*e).binding(), *rs[0]);
+    default:
+      return &normalize_atom(fac, *e);
+    }
+  }
+
+  // A conjunction or disjunction drops its unit operands. The operands
+  // after one that decides it were skipped.
+  const Expr& connective(const Expr& e, const Expr** rs, std::size_t n) {
+    Nary::Operands es;
+    es.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      if (decides(e, *rs[i]))
+        return *rs[i];
+      if (not is<Bool>(*rs[i]))
+        es.push_back(rs[i]);
+    }
+    if (unit(e))
+      return fac.make_and(std::move(es));
+    else
+      return fac.make_or(std::move(es));
+  }
+
+  Expr::Factory& fac;
+};
+
+} // namespace
+
+const Expr&
+normalize(Expr::Factory& f, const Expr& e) {
+  Normalize_walker w(f);
+  return *traverse(w, &e);
+}
+
+} // namespace sarah
@@ -0,0 +1,35 @@
+#ifndef SARAH_NORMALIZE_HPP
+#define SARAH_NORMALIZE_HPP
+
+#include "Language.hpp"
+
+namespace sarah {
+
+// Linear normalization
+//
+// Each arithmetic atom is rewritten as a constraint on a single linear
+// term t, divided through by the gcd of its coefficients:
+//
+//    a == b, a != b        t == 0, t != 0
+//    a < b, a <= b         t <= 0
+//    a > b, a >= b         t <= 0
+//    n | a                 n | t
+//
+// Strict inequalities are tightened by 1, and the constant of an
+// inequality is rounded towards the feasible side after division. The
+// first coefficient of an equation or divisibility constraint is made
+// positive. Atoms without variables are evaluated, so two atoms that
+// differ only by a rearrangement or a common factor become the same
+// expression.
+
+// Returns the linear term equal to the arithmetic expression e.
+const Linear& linearize(Expr::Factory&, const Expr& e);
+
+// Returns the formula e with each of its arithmetic atoms in canonical
+// linear form. Logical connectives and quantifiers are rebuilt around the
+// normalized atoms.
+const Expr& normalize(Expr::Factory&, const Expr& e);
+
+} // namespace sarah
+
+#endif
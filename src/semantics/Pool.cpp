@@ -0,0 +1,372 @@
+#include <cassert>
+#include <unordered_map>
+
+#include <utility/Traversal.hpp>
+#include <utility/Utility.hpp>
+
+#include "Pool.hpp"
+
+namespace sarah {
+
+// -------------------------------------------------------------------------- //
+// Construction
+
+Expr_id
+Expr_pool::make(Expr_kind k, Expr_id a, Expr_id b) {
+  assert(kinds.size() < no_expr);
+  Expr_id e = kinds.size();
+  kinds.push_back(k);
+  firsts.push_back(a);
+  seconds.push_back(b);
+  return e;
+}
+
+Expr_id
+Expr_pool::make_id(String s) { return make(Id_kind, s.id(), no_expr); }
+
+Expr_id
+Expr_pool::make_bool(bool b) { return make(Bool_kind, b, no_expr); }
+
+Expr_id
+Expr_pool::make_int(const Integer& n) {
+  ints.push_back(n);
+  return make(Int_kind, ints.size() - 1, no_expr);
+}
+
+Expr_id
+Expr_pool::make_var(Expr_id n, const Decl& d, std::size_t k) {
+  assert(kind(n) == Id_kind);
+  decls.push_back(&d);
+  indices.push_back(k);
+  return make(Var_kind, n, decls.size() - 1);
+}
+
+Expr_id
+Expr_pool::make_unary(Expr_kind k, Expr_id a) {
+  assert(a < size());
+  return make(k, a, no_expr);
+}
+
+Expr_id
+Expr_pool::make_binary(Expr_kind k, Expr_id a, Expr_id b) {
+  assert(a < size() and b < size());
+  return make(k, a, b);
+}
+
+Expr_id
+Expr_pool::make_nary(Expr_kind k, const std::vector<Expr_id>& es) {
+  assert(k == And_kind or k == Or_kind);
+  Expr_id first = lists.size();
+  lists.insert(lists.end(), es.begin(), es.end());
+  return make(k, first, es.size());
+}
+
+Expr_id
+Expr_pool::make_linear(const std::vector<Expr_id>& vs,
+                       const std::vector<Integer>& cs, const Integer& c) {
+  assert(vs.size() == cs.size());
+  Expr_id first = lists.size();
+  lists.push_back(ints.size());
+  ints.push_back(c);
+  for (std::size_t i = 0; i < vs.size(); ++i) {
+    assert(kind(vs[i]) == Var_kind);
+    lists.push_back(vs[i]);
+    lists.push_back(ints.size());
+    ints.push_back(cs[i]);
+  }
+  return make(Linear_kind, first, vs.size());
+}
+
+Expr_id
+Expr_pool::make_type(Expr_kind k) {
+  assert(k >= Bool_type_kind);
+  return make(k, no_expr, no_expr);
+}
+
+void
+Expr_pool::clear() {
+  kinds.clear();
+  firsts.clear();
+  seconds.clear();
+  ints.clear();
+  decls.clear();
+  indices.clear();
+  lists.clear();
+}
+
+// -------------------------------------------------------------------------- //
+// Equality
+
+namespace {
+
+// Bound variables are the same when they have the same index and type,
+// and other variables when they refer to the same declaration.
+inline bool
+same_var(const Expr_pool& p, Expr_id a, Expr_id b) {
+  if (p.index(a) != Var::unbound or p.index(b) != Var::unbound)
+    return p.index(a) == p.index(b) and &p.decl(a).type == &p.decl(b).type;
+  return &p.decl(a) == &p.decl(b);
+}
+
+// The variables of linear terms are in canonical order. Each list holds
+// the constant, then a variable and coefficient for each term.
+inline bool
+same_linear(const Expr_pool& p, Expr_id a, Expr_id b) {
+  if (p.arity(a) != p.arity(b))
+    return false;
+  const Expr_id* x = p.operands(a);
+  const Expr_id* y = p.operands(b);
+  if (p.integer_at(x[0]) != p.integer_at(y[0]))
+    return false;
+  for (std::size_t i = 1; i < 2 * p.arity(a); i += 2)
+    if (not same_var(p, x[i], y[i])
+        or p.integer_at(x[i + 1]) != p.integer_at(y[i + 1]))
+      return false;
+  return true;
+}
+
+} // namespace
+
+// Pairs of operands are compared from a worklist over the pool's arrays,
+// so nothing is exported. Shared operands have the same id and are not
+// compared further.
+bool
+same(const Expr_pool& p, Expr_id a, Expr_id b) {
+  std::vector<std::pair<Expr_id, Expr_id>> work {{a, b}};
+  while (not work.empty()) {
+    Expr_id x = work.back().first;
+    Expr_id y = work.back().second;
+    work.pop_back();
+    if (x == y)
+      continue;
+    Expr_kind k = p.kind(x);
+    if (k != p.kind(y))
+      return false;
+    switch (k) {
+    case Id_kind: case Bool_kind:
+      if (p.first(x) != p.first(y))
+        return false;
+      break;
+    case Int_kind:
+      if (p.integer(x) != p.integer(y))
+        return false;
+      break;
+    case Var_kind:
+      if (not same_var(p, x, y))
+        return false;
+      break;
+    case Linear_kind:
+      if (not same_linear(p, x, y))
+        return false;
+      break;
+    case And_kind: case Or_kind: {
+      if (p.arity(x) != p.arity(y))
+        return false;
+      const Expr_id* xs = p.operands(x);
+      const Expr_id* ys = p.operands(y);
+      for (std::size_t i = 0; i < p.arity(x); ++i)
+        work.emplace_back(xs[i], ys[i]);
+      break;
+    }
+    case Bind_kind:
+      // The names of bindings are ignored.
+      work.emplace_back(p.second(x), p.second(y));
+      break;
+    case Neg_kind: case Pos_kind: case Not_kind:
+      work.emplace_back(p.first(x), p.first(y));
+      break;
+    case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+      break;
+    default:
+      work.emplace_back(p.first(x), p.first(y));
+      work.emplace_back(p.second(x), p.second(y));
+      break;
+    }
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------------- //
+// Conversion
+
+namespace {
+
+// Copies expressions into a pool after their operands. Each expression
+// object is copied once, so shared subexpressions are shared in the pool.
+struct Importer : Walker<const Expr*, Expr_id> {
+  Importer(Expr_pool& p)
+    : pool(p) { }
+
+  void enter(const Expr* e, std::vector<const Expr*>& es) {
+    if (ids.count(e))
+      return;
+    for (std::size_t i = 0; i < arity(*e); ++i)
+      es.push_back(&operand(*e, i));
+  }
+
+  Expr_id leave(const Expr* e, Expr_id* rs, std::size_t n) {
+    auto i = ids.find(e);
+    if (i != ids.end())
+      return i->second;
+    Expr_id id = import(*e, rs, n);
+    ids.insert({e, id});
+    return id;
+  }
+
+  // Copies e, given the ids of its n operands.
+  Expr_id import(const Expr& e, const Expr_id* rs, std::size_t n) {
+    switch (e.tag) {
+    case Id_kind:
+      return pool.make_id(as<Id>(e).str());
+    case Bool_kind:
+      return pool.make_bool(as<Bool>(e).value());
+    case Int_kind:
+      return pool.make_int(as<Int>(e).value());
+    case Var_kind:
+      return pool.make_var(rs[0], as<Var>(e).decl(), as<Var>(e).index());
+    case And_kind: case Or_kind:
+      return pool.make_nary(e.tag, std::vector<Expr_id>(rs, rs + n));
+    case Neg_kind: case Pos_kind: case Not_kind:
+      return pool.make_unary(e.tag, rs[0]);
+    case Linear_kind: {
+      const Linear& l = as<Linear>(e);
+      std::vector<Expr_id> vs(rs, rs + n);
+      return pool.make_linear(vs, l.coeffs, l.constant());
+    }
+    case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+      return pool.make_type(e.tag);
+    default:
+      return pool.make_binary(e.tag, rs[0], rs[1]);
+    }
+  }
+
+  Expr_pool& pool;
+  std::unordered_map<const Expr*, Expr_id> ids;
+};
+
+// Rebuilds pooled expressions with a factory. Each id is rebuilt once,
+// after its operands.
+struct Exporter {
+  const Expr& operator()(Expr_id e) {
+    assert(exprs[e]);
+    return *exprs[e];
+  }
+
+  // Marks the operands of e as used.
+  void mark(Expr_id e, std::vector<bool>& used) {
+    switch (pool.kind(e)) {
+    case Id_kind: case Bool_kind: case Int_kind:
+    case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+      return;
+    case Var_kind: case Neg_kind: case Pos_kind: case Not_kind:
+      used[pool.first(e)] = true;
+      return;
+    case And_kind: case Or_kind:
+      for (std::size_t i = 0; i < pool.arity(e); ++i)
+        used[pool.operands(e)[i]] = true;
+      return;
+    case Linear_kind:
+      for (std::size_t i = 0; i < pool.arity(e); ++i)
+        used[pool.operands(e)[1 + 2 * i]] = true;
+      return;
+    default:
+      used[pool.first(e)] = true;
+      used[pool.second(e)] = true;
+      return;
+    }
+  }
+
+  template<typename T>
+    const T& get(Expr_id e) { return as<T>((*this)(e)); }
+
+  Nary::Operands operands(Expr_id e) {
+    Nary::Operands es;
+    const Expr_id* ids = pool.operands(e);
+    for (std::size_t i = 0; i < pool.arity(e); ++i)
+      es.push_back(&(*this)(ids[i]));
+    return es;
+  }
+
+  const Linear& linear(Expr_id e) {
+    const Expr_id* list = pool.operands(e);
+    Linear::Vars vs;
+    Linear::Coeffs cs;
+    for (std::size_t i = 0; i < pool.arity(e); ++i) {
+      vs.push_back(&get<Var>(list[1 + 2 * i]));
+      cs.push_back(pool.integer_at(list[2 + 2 * i]));
+    }
+    return fac.make_linear(vs, cs, pool.integer_at(list[0]));
+  }
+
+  const Expr& build(Expr_id e) {
+    Expr_id a = pool.first(e);
+    Expr_id b = pool.second(e);
+    switch (pool.kind(e)) {
+    case Id_kind: return fac.make_id(pool.name(e));
+    case Bool_kind: return fac.make_bool(pool.boolean(e));
+    case Int_kind: return fac.make_int(pool.integer(e));
+    case Var_kind:
+      return fac.make_var(get<Id>(a), pool.decl(e), pool.index(e));
+    case Add_kind: return fac.make_add(get<Expr>(a), get<Expr>(b));
+    case Sub_kind: return fac.make_sub(get<Expr>(a), get<Expr>(b));
+    case Mul_kind: return fac.make_mul(get<Int>(a), get<Expr>(b));
+    case Div_kind: return fac.make_div(get<Int>(a), get<Expr>(b));
+    case Neg_kind: return fac.make_neg(get<Expr>(a));
+    case Pos_kind: return fac.make_pos(get<Expr>(a));
+    case Linear_kind: return linear(e);
+    case Eq_kind: return fac.make_eq(get<Expr>(a), get<Expr>(b));
+    case Ne_kind: return fac.make_ne(get<Expr>(a), get<Expr>(b));
+    case Lt_kind: return fac.make_lt(get<Expr>(a), get<Expr>(b));
+    case Gt_kind: return fac.make_gt(get<Expr>(a), get<Expr>(b));
+    case Le_kind: return fac.make_le(get<Expr>(a), get<Expr>(b));
+    case Ge_kind: return fac.make_ge(get<Expr>(a), get<Expr>(b));
+    case And_kind: return fac.make_and(operands(e));
+    case Or_kind: return fac.make_or(operands(e));
+    case Imp_kind: return fac.make_imp(get<Expr>(a), get<Expr>(b));
+    case Iff_kind: return fac.make_iff(get<Expr>(a), get<Expr>(b));
+    case Not_kind: return fac.make_not(get<Expr>(a));
+    case Bind_kind: return fac.make_bind(get<Id>(a), get<Type>(b));
+    case Exists_kind: return fac.make_exists(get<Bind>(a), get<Expr>(b));
+    case Forall_kind: return fac.make_forall(get<Bind>(a), get<Expr>(b));
+    case Bool_type_kind: return fac.make_bool_type();
+    case Int_type_kind: return fac.make_int_type();
+    case Kind_type_kind: return fac.make_kind_type();
+    }
+    assert(false && "unknown expression kind");
+    return fac.make_bool(false);
+  }
+
+  const Expr_pool& pool;
+  Expr::Factory& fac;
+  std::vector<const Expr*> exprs;
+};
+
+} // namespace
+
+// Copy the expression e into the pool, returning its id.
+Expr_id
+Expr_pool::import(const Expr& e) {
+  Importer imp(*this);
+  return traverse(imp, &e);
+}
+
+// Build the pooled expression e using fac. The result can be visited and
+// printed like any other expression. Since operands have smaller ids than
+// the expressions that use them, the expressions under e are found in one
+// pass down from e, and built in one pass up.
+const Expr&
+Expr_pool::export_expr(Expr::Factory& fac, Expr_id e) const {
+  assert(e < size());
+  Exporter exp {*this, fac, std::vector<const Expr*>(e + 1)};
+  std::vector<bool> used(e + 1);
+  used[e] = true;
+  for (Expr_id i = e + 1; i-- > 0; )
+    if (used[i])
+      exp.mark(i, used);
+  for (Expr_id i = 0; i <= e; ++i)
+    if (used[i])
+      exp.exprs[i] = &exp.build(i);
+  return exp(e);
+}
+
+} // namespace sarah
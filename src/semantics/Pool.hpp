@@ -0,0 +1,108 @@
+#ifndef SARAH_POOL_HPP
+#define SARAH_POOL_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "Language.hpp"
+
+namespace sarah {
+
+// An Expr_id names an expression in an Expr_pool.
+using Expr_id = std::uint32_t;
+
+// The id of no expression.
+constexpr Expr_id no_expr = ~Expr_id(0);
+
+// An Expr_pool is a compact representation of expressions. Expressions
+// are numbered in the order they are made, and the kind and operands of
+// each are stored in parallel arrays indexed by its id, so a node takes
+// 9 bytes instead of an object with a vtable and operand pointers.
+//
+// The operands of an expression are always made before it, so every id
+// is greater than the ids of its operands, and a pass over a whole pool
+// can be a loop over its ids. The meaning of an expression's operands
+// depends on its kind:
+//
+//   Id            first is the symbol id of the name
+//   Bool          first is 0 or 1
+//   Int           first indexes the pool's integers
+//   Var           first is the name (an Id) and second indexes the
+//                 pool's declarations and de Bruijn indices
+//   unary         first is the operand
+//   binary        first and second are the operands; for Mul and Div,
+//                 first is an Int
+//   And, Or       first indexes the pool's operand lists and second is
+//                 the number of operands
+//   Linear        first indexes the pool's operand lists and second is
+//                 the number of variables; the list holds the index of
+//                 the constant in the pool's integers, followed by each
+//                 variable and the index of its coefficient
+//   Bind          first is the name (an Id) and second is the type
+//   quantifiers   first is the binding and second is the body
+//   types         no operands
+//
+// Pooled expressions are converted to and from ordinary expressions by
+// import and export, which preserve sharing. Equality is computed on the
+// pool itself.
+class Expr_pool {
+public:
+  // Returns the number of expressions in the pool.
+  std::size_t size() const { return kinds.size(); }
+
+  // Construction
+  Expr_id make_id(String);
+  Expr_id make_bool(bool);
+  Expr_id make_int(const Integer&);
+  Expr_id make_var(Expr_id, const Decl&, std::size_t = Var::unbound);
+  Expr_id make_unary(Expr_kind, Expr_id);
+  Expr_id make_binary(Expr_kind, Expr_id, Expr_id);
+  Expr_id make_nary(Expr_kind, const std::vector<Expr_id>&);
+  Expr_id make_linear(const std::vector<Expr_id>&,
+                      const std::vector<Integer>&, const Integer&);
+  Expr_id make_type(Expr_kind);
+
+  // Observers
+  Expr_kind kind(Expr_id e) const { return kinds[e]; }
+  Expr_id first(Expr_id e) const { return firsts[e]; }
+  Expr_id second(Expr_id e) const { return seconds[e]; }
+
+  String name(Expr_id e) const { return String::from_id(firsts[e]); }
+  bool boolean(Expr_id e) const { return firsts[e]; }
+  const Integer& integer(Expr_id e) const { return ints[firsts[e]]; }
+  const Decl& decl(Expr_id e) const { return *decls[seconds[e]]; }
+  std::size_t index(Expr_id e) const { return indices[seconds[e]]; }
+
+  std::size_t arity(Expr_id e) const { return seconds[e]; }
+  const Expr_id* operands(Expr_id e) const { return &lists[firsts[e]]; }
+
+  // Returns the integer at index i, as stored in an operand list.
+  const Integer& integer_at(Expr_id i) const { return ints[i]; }
+
+  // Conversion
+  Expr_id import(const Expr&);
+  const Expr& export_expr(Expr::Factory&, Expr_id) const;
+
+  // Discards every expression in the pool.
+  void clear();
+
+private:
+  Expr_id make(Expr_kind, Expr_id, Expr_id);
+
+  std::vector<Expr_kind> kinds;
+  std::vector<Expr_id> firsts;
+  std::vector<Expr_id> seconds;
+  std::vector<Integer> ints;
+  std::vector<const Decl*> decls;
+  std::vector<std::size_t> indices;
+  std::vector<Expr_id> lists;
+};
+
+// Returns true when the pooled expressions a and b are the same, in the
+// sense of same() on the expressions they were imported from. Types are
+// compared by kind, since the pool does not keep their identity.
+bool same(const Expr_pool&, Expr_id a, Expr_id b);
+
+} // namespace sarah
+
+#endif
@@ -1,8 +1,9 @@
 // Working on identity translator to start off
 #include <cassert>
-#include <iostream>
+#include <stack>
 
 #include "utility/Diagnostics.hpp"
+#include "utility/Traversal.hpp"
 #include "syntax/Tree.hpp"
 #include "syntax/Sexpr.hpp"
 
@@ -34,38 +35,33 @@ translate_int(Translator& t, const Int& expr) {
 
 Elaboration
 translate_var(Translator& t, const Var& expr) {
-  return { t.context.make_var(expr.name(),expr.decl()), expr.decl().type };
+  const Var& v = t.context.make_var(expr.name(),expr.decl(),expr.index());
+  return { v, expr.type() };
 }
 
+// The translations of the operands of an arithmetic or relational
+// expression are es[0] and es[1].
 Elaboration
-translate_add(Translator& t, const Add& expr) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
-  return { t.context.make_add(e1.expr(),e2.expr()), t.context.int_type };
+translate_add(Translator& t, const Elaboration* es) {
+  return { t.context.make_add(es[0].expr(),es[1].expr()), t.context.int_type };
 }
 
 Elaboration
-translate_sub(Translator& t, const Sub& expr) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
-  return { t.context.make_sub(e1.expr(),e2.expr()), t.context.int_type };
+translate_sub(Translator& t, const Elaboration* es) {
+  return { t.context.make_sub(es[0].expr(),es[1].expr()), t.context.int_type };
 }
 
 Elaboration
-translate_mul(Translator& t, const Mul& expr) {
-  Elaboration e1 = t(expr.first());
-  Elaboration e2 = t(expr.second());
+translate_mul(Translator& t, const Elaboration* es) {
   return {
-    t.context.make_mul(as<Int>(e1.expr()),e2.expr()), t.context.int_type
+    t.context.make_mul(as<Int>(es[0].expr()),es[1].expr()), t.context.int_type
   };
 }
 
 Elaboration
-translate_div(Translator& t, const Div& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.first());
-  Elaboration e2 = t(expr.second());
+translate_div(Translator& t, const Elaboration* es, bool carrying_not) {
   Elaboration e = {
-    t.context.make_div(as<Int>(e1.expr()),e2.expr()),
+    t.context.make_div(as<Int>(es[0].expr()),es[1].expr()),
     t.context.bool_type
   };
   if (carrying_not ) {
@@ -76,123 +72,135 @@ translate_div(Translator& t, const Div& expr, bool carrying_not) {
 }
 
 Elaboration
-translate_neg(Translator& t, const Neg& expr) {
-  Elaboration e = t(expr.arg());
-  return { t.context.make_neg(e.expr()), t.context.int_type };
+translate_neg(Translator& t, const Elaboration* es) {
+  return { t.context.make_neg(es[0].expr()), t.context.int_type };
 }
 
 Elaboration
-translate_pos(Translator& t, const Pos& expr) {
-  Elaboration e = t(expr.arg());
-  return { t.context.make_pos(e.expr()), t.context.int_type };
+translate_pos(Translator& t, const Elaboration* es) {
+  return { t.context.make_pos(es[0].expr()), t.context.int_type };
 }
 
 Elaboration
-translate_eq(Translator& t, const Eq& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
+translate_linear(Translator& t, const Linear& expr) {
+  return {
+    t.context.make_linear(expr.vars,expr.coeffs,expr.constant()),
+    t.context.int_type
+  };
+}
+
+Elaboration
+translate_eq(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Expr& e1 = es[0].expr();
+  const Expr& e2 = es[1].expr();
   if (carrying_not)
-    return { t.context.make_ne(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_ne(e1,e2), t.context.bool_type };
   else
-    return { t.context.make_eq(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_eq(e1,e2), t.context.bool_type };
 }
 
 Elaboration
-translate_ne(Translator& t, const Ne& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
+translate_ne(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Expr& e1 = es[0].expr();
+  const Expr& e2 = es[1].expr();
   if (carrying_not)
-    return { t.context.make_eq(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_eq(e1,e2), t.context.bool_type };
   else
-    return { t.context.make_ne(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_ne(e1,e2), t.context.bool_type };
 }
 
 Elaboration
-translate_lt(Translator& t, const Lt& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
+translate_lt(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Expr& e1 = es[0].expr();
+  const Expr& e2 = es[1].expr();
   if (carrying_not)
-    return { t.context.make_ge(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_ge(e1,e2), t.context.bool_type };
   else
-    return { t.context.make_lt(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_lt(e1,e2), t.context.bool_type };
 }
 
 Elaboration
-translate_gt(Translator& t, const Gt& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
+translate_gt(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Expr& e1 = es[0].expr();
+  const Expr& e2 = es[1].expr();
   if (carrying_not)
-    return { t.context.make_le(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_le(e1,e2), t.context.bool_type };
   else
-    return { t.context.make_gt(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_gt(e1,e2), t.context.bool_type };
 }
 
 Elaboration
-translate_le(Translator& t, const Le& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
+translate_le(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Expr& e1 = es[0].expr();
+  const Expr& e2 = es[1].expr();
   if (carrying_not)
-    return { t.context.make_gt(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_gt(e1,e2), t.context.bool_type };
   else
-    return { t.context.make_le(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_le(e1,e2), t.context.bool_type };
 }
 
 Elaboration
-translate_ge(Translator& t, const Ge& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.left());
-  Elaboration e2 = t(expr.right());
+translate_ge(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Expr& e1 = es[0].expr();
+  const Expr& e2 = es[1].expr();
   if (carrying_not)
-    return { t.context.make_lt(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_lt(e1,e2), t.context.bool_type };
   else
-    return { t.context.make_ge(e1.expr(),e2.expr()), t.context.bool_type };
+    return { t.context.make_ge(e1,e2), t.context.bool_type };
 }
 
-Elaboration
-translate_and(Translator& t, const And& expr, bool carrying_not) {
-  if (carrying_not) {
-    Elaboration e1 = t.translate(expr.left(),true);
-    Elaboration e2 = t.translate(expr.right(),true);
-    return { t.context.make_or(e1.expr(),e2.expr()), t.context.bool_type };
-  } else {
-    Elaboration e1 = t(expr.left());
-    Elaboration e2 = t(expr.right());
-    return { t.context.make_and(e1.expr(),e2.expr()), t.context.bool_type };
-  }
+// The operands of an n-ary expression are translated with the same
+// polarity as the expression.
+Nary::Operands
+translated_operands(const Elaboration* es, std::size_t n) {
+  Nary::Operands ops;
+  ops.reserve(n);
+  for (std::size_t i = 0; i < n; ++i)
+    ops.push_back(&es[i].expr());
+  return ops;
 }
 
 Elaboration
-translate_or(Translator& t, const Or& expr, bool carrying_not) {
-  if (carrying_not) {
-    Elaboration e1 = t.translate(expr.left(),true);
-    Elaboration e2 = t.translate(expr.right(),true);
-    return { t.context.make_and(e1.expr(),e2.expr()), t.context.bool_type };
-  } else {
-    Elaboration e1 = t(expr.left());
-    Elaboration e2 = t(expr.right());
-    return { t.context.make_or(e1.expr(),e2.expr()), t.context.bool_type };
-  }
+translate_and(Translator& t, const Elaboration* es, std::size_t n,
+              bool carrying_not) {
+  Nary::Operands ops = translated_operands(es,n);
+  if (carrying_not)
+    return { t.context.make_or(std::move(ops)), t.context.bool_type };
+  else
+    return { t.context.make_and(std::move(ops)), t.context.bool_type };
 }
 
 Elaboration
-translate_imp(Translator& t, const Imp& expr, bool carrying_not) {
-  if (carrying_not) {
-    Elaboration e1 = t.translate(expr.left(),false);
-    Elaboration e2 = t.translate(expr.right(),true);
-    return { t.context.make_and(e1.expr(),e2.expr()), t.context.bool_type };
-  } else {
-    Elaboration e1 = t.translate(expr.left(),true);
-    Elaboration e2 = t.translate(expr.right(),false);
-    return { t.context.make_or(e1.expr(),e2.expr()), t.context.bool_type };
-  }
+translate_or(Translator& t, const Elaboration* es, std::size_t n,
+             bool carrying_not) {
+  Nary::Operands ops = translated_operands(es,n);
+  if (carrying_not)
+    return { t.context.make_and(std::move(ops)), t.context.bool_type };
+  else
+    return { t.context.make_or(std::move(ops)), t.context.bool_type };
 }
 
+// The left operand of an implication is translated with the opposite
+// polarity, and the right with the same polarity.
+Elaboration
+translate_imp(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Expr& e1 = es[0].expr();
+  const Expr& e2 = es[1].expr();
+  if (carrying_not)
+    return { t.context.make_and(e1,e2), t.context.bool_type };
+  else
+    return { t.context.make_or(e1,e2), t.context.bool_type };
+}
 
+// Each operand of an equivalence is translated with both polarities:
+// es[0] and es[1] are the left operand negated and not, and es[2] and
+// es[3] the right.
 Elaboration
-translate_iff(Translator& t, const Iff& expr, bool carrying_not) {
-  Elaboration e1 = t.translate(expr.left(),true);
-  Elaboration e2 = t.translate(expr.left(),false);
-  Elaboration e3 = t.translate(expr.right(),true);
-  Elaboration e4 = t.translate(expr.right(),false);
+translate_iff(Translator& t, const Elaboration* es, bool carrying_not) {
+  const Elaboration& e1 = es[0];
+  const Elaboration& e2 = es[1];
+  const Elaboration& e3 = es[2];
+  const Elaboration& e4 = es[3];
 
   if (carrying_not) {
     Elaboration left = {
@@ -217,17 +225,10 @@ translate_iff(Translator& t, const Iff& expr, bool carrying_not) {
   }
 }
 
-
+// The operand of a negation is translated with the opposite polarity.
 Elaboration
-translate_not(Translator& t, const Not& expr, bool carrying_not) {
-  if (carrying_not)
-  {
-    Elaboration e = t(expr.arg());
-    return e;
-  } else {
-    Elaboration e = t.translate(expr.arg(),true);
-    return e;
-  }
+translate_not(Translator& t, const Elaboration* es) {
+  return es[0];
 }
 
 Elaboration
@@ -235,38 +236,33 @@ translate_bind(Translator& t, const Bind& expr) {
   return { t.context.make_bind(expr.name(), expr.type()), expr.type() };
 }
 
+// The translation of a quantified expression is discarded if its body
+// cannot be translated. The body is translated in a scope that is
+// opened after the binding, and closed here.
 Elaboration
-translate_exists(Translator& t, const Exists& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.binding());
+translate_exists(Translator& t, const Elaboration* es, bool carrying_not,
+                 Factory_scope& scope) {
+  if (not es[1])
+    return {};
+  scope.keep();
+  const Bind& b = as<Bind>(es[0].expr());
   if (carrying_not)
-  {
-    Elaboration e2 = t.translate(expr.expr(),true);
-    return {
-      t.context.make_forall(as<Bind>(e1.expr()),e2.expr()), t.context.bool_type
-    };
-  } else {
-    Elaboration e2 = t.translate(expr.expr(),false);
-    return {
-      t.context.make_exists(as<Bind>(e1.expr()),e2.expr()), t.context.bool_type
-    };
-  }
+    return { t.context.make_forall(b,es[1].expr()), t.context.bool_type };
+  else
+    return { t.context.make_exists(b,es[1].expr()), t.context.bool_type };
 }
 
 Elaboration
-translate_forall(Translator& t, const Forall& expr, bool carrying_not) {
-  Elaboration e1 = t(expr.binding());
+translate_forall(Translator& t, const Elaboration* es, bool carrying_not,
+                 Factory_scope& scope) {
+  if (not es[1])
+    return {};
+  scope.keep();
+  const Bind& b = as<Bind>(es[0].expr());
   if (carrying_not)
-  {
-    Elaboration e2 = t.translate(expr.expr(),true);
-    return {
-      t.context.make_exists(as<Bind>(e1.expr()),e2.expr()), t.context.bool_type
-    };
-  } else {
-    Elaboration e2 = t.translate(expr.expr(),false);
-    return {
-      t.context.make_forall(as<Bind>(e1.expr()),e2.expr()), t.context.bool_type
-    };
-  }
+    return { t.context.make_exists(b,es[1].expr()), t.context.bool_type };
+  else
+    return { t.context.make_forall(b,es[1].expr()), t.context.bool_type };
 }
 
 Elaboration
@@ -284,111 +280,145 @@ translate_kind_type(Translator& t, const Kind_type& expr) {
   return { t.context.make_kind_type(), t.context.kind_type };
 }
 
-Elaboration
-translate_type(Translator& t, const Expr& expr) {
-  std::cout << "type" << std::endl;
-  return Elaboration();
-}
-
-Elaboration
-translate_expr(Translator& t, const Expr& expr) {
-  std::cout << "expr" << std::endl;
-  return Elaboration();
-}
-
-} // namespace
-
-Elaboration
-Translator::translate(const Expr& expr, bool carrying_not) {
-  struct V : Expr::Visitor {
-    V(Translator& t, bool cn)
-      : translator(t), carrying_not(cn) { }
-
-    void visit_expr(const Expr& expr) {
-      result = translate_expr(translator,expr);
-    }
-
-    void visit(const Id& expr) { result = translate_id(translator,expr); }
-    void visit(const Bool& expr) { result = translate_bool(translator,expr); }
-    void visit(const Int& expr) { result = translate_int(translator,expr); }
-    void visit(const Var& expr) { result = translate_var(translator,expr); }
-
-    void visit(const Add& expr) { result = translate_add(translator,expr); }
-    void visit(const Sub& expr) { result = translate_sub(translator,expr); }
-    void visit(const Mul& expr) { result = translate_mul(translator,expr); }
-    void visit(const Neg& expr) { result = translate_neg(translator,expr); }
-    void visit(const Pos& expr) { result = translate_pos(translator,expr); }
+// Dispatches to the translation of each kind of expression, given the
+// translations es of the nodes visited under it.
+struct Translate_fn {
+  Translator& t;
+  bool carrying_not;
+  const Elaboration* es;
+  std::size_t n;
+  std::stack<Factory_scope>& scopes;
+
+  Elaboration operator()(const Id& e) { return translate_id(t,e); }
+  Elaboration operator()(const Bool& e) { return translate_bool(t,e); }
+  Elaboration operator()(const Int& e) { return translate_int(t,e); }
+  Elaboration operator()(const Var& e) { return translate_var(t,e); }
+
+  Elaboration operator()(const Add&) { return translate_add(t,es); }
+  Elaboration operator()(const Sub&) { return translate_sub(t,es); }
+  Elaboration operator()(const Mul&) { return translate_mul(t,es); }
+  Elaboration operator()(const Neg&) { return translate_neg(t,es); }
+  Elaboration operator()(const Pos&) { return translate_pos(t,es); }
+  Elaboration operator()(const Linear& e) { return translate_linear(t,e); }
+
+  Elaboration operator()(const Div&) {
+    return translate_div(t,es,carrying_not);
+  }
+  Elaboration operator()(const Eq&) { return translate_eq(t,es,carrying_not); }
+  Elaboration operator()(const Ne&) { return translate_ne(t,es,carrying_not); }
+  Elaboration operator()(const Lt&) { return translate_lt(t,es,carrying_not); }
+  Elaboration operator()(const Gt&) { return translate_gt(t,es,carrying_not); }
+  Elaboration operator()(const Le&) { return translate_le(t,es,carrying_not); }
+  Elaboration operator()(const Ge&) { return translate_ge(t,es,carrying_not); }
+
+  Elaboration operator()(const And&) {
+    return translate_and(t,es,n,carrying_not);
+  }
+  Elaboration operator()(const Or&) {
+    return translate_or(t,es,n,carrying_not);
+  }
+  Elaboration operator()(const Imp&) {
+    return translate_imp(t,es,carrying_not);
+  }
+  Elaboration operator()(const Iff&) {
+    return translate_iff(t,es,carrying_not);
+  }
+  Elaboration operator()(const Not&) { return translate_not(t,es); }
+  Elaboration operator()(const Bind& e) { return translate_bind(t,e); }
 
+  Elaboration operator()(const Exists&) {
+    Elaboration e = translate_exists(t,es,carrying_not,scopes.top());
+    scopes.pop();
+    return e;
+  }
+  Elaboration operator()(const Forall&) {
+    Elaboration e = translate_forall(t,es,carrying_not,scopes.top());
+    scopes.pop();
+    return e;
+  }
 
-    void visit(const Div& expr) {
-      result = translate_div(translator,expr,carrying_not);
-    }
-    void visit(const Eq& expr) {
-      result = translate_eq(translator,expr,carrying_not);
-    }
-    void visit(const Ne& expr) {
-      result = translate_ne(translator,expr,carrying_not);
-    }
-    void visit(const Lt& expr) {
-      result = translate_lt(translator,expr,carrying_not);
-    }
-    void visit(const Gt& expr) {
-      result = translate_gt(translator,expr,carrying_not);
-    }
-    void visit(const Le& expr) {
-      result = translate_le(translator,expr,carrying_not);
-    }
-    void visit(const Ge& expr) {
-      result = translate_ge(translator,expr,carrying_not);
+  Elaboration operator()(const Bool_type& e) {
+    return translate_bool_type(t,e);
+  }
+  Elaboration operator()(const Int_type& e) {
+    return translate_int_type(t,e);
+  }
+  Elaboration operator()(const Kind_type& e) {
+    return translate_kind_type(t,e);
+  }
+};
+
+// An expression to translate, and whether it is negated.
+struct Translation {
+  const Expr* expr;
+  bool carrying_not;
+};
+
+// Translates the operands of an expression before the expression itself.
+// Which operands are visited, and with what polarity, depends on the kind
+// of expression.
+struct Translate_walker : Walker<Translation, Elaboration> {
+  Translate_walker(Translator& t)
+    : translator(t) { }
+
+  void enter(const Node& n, std::vector<Node>& ns) {
+    const Expr& e = *n.expr;
+    bool neg = n.carrying_not;
+    switch (e.tag) {
+    case Id_kind: case Bool_kind: case Int_kind: case Var_kind:
+    case Linear_kind: case Bind_kind:
+    case Bool_type_kind: case Int_type_kind: case Kind_type_kind:
+      return;
+    case And_kind: case Or_kind:
+      for (const Expr* x : as<Nary>(e))
+        ns.push_back({x,neg});
+      return;
+    case Imp_kind:
+      ns.push_back({&operand(e,0),not neg});
+      ns.push_back({&operand(e,1),neg});
+      return;
+    case Iff_kind:
+      for (std::size_t i = 0; i < 2; ++i) {
+        ns.push_back({&operand(e,i),true});
+        ns.push_back({&operand(e,i),false});
+      }
+      return;
+    case Not_kind:
+      ns.push_back({&operand(e,0),not neg});
+      return;
+    case Exists_kind: case Forall_kind:
+      ns.push_back({&operand(e,0),false});
+      ns.push_back({&operand(e,1),neg});
+      return;
+    default:
+      // Arithmetic and relational operands are never negated.
+      for (std::size_t i = 0; i < arity(e); ++i)
+        ns.push_back({&operand(e,i),false});
     }
+  }
 
-    void visit(const And& expr) {
-      result = translate_and(translator,expr,carrying_not);
-    }
-    void visit(const Or& expr) {
-      result = translate_or(translator,expr,carrying_not);
-    }
-    void visit(const Imp& expr) {
-      result = translate_imp(translator,expr,carrying_not);
-    }
-    void visit(const Iff& expr) {
-      result = translate_iff(translator,expr,carrying_not);
-    }
-    void visit(const Not& expr) {
-      result = translate_not(translator,expr,carrying_not);
-    }
-    void visit(const Bind& expr) {
-      result = translate_bind(translator,expr);
-    }
+  // The body of a quantifier is translated in a new scope.
+  bool next(const Node& n, std::size_t i, const Elaboration*) {
+    if (i == 1 and (is<Exists>(*n.expr) or is<Forall>(*n.expr)))
+      scopes.emplace(translator.context);
+    return true;
+  }
 
-    void visit(const Exists& expr) {
-      result = translate_exists(translator,expr,carrying_not);
-    }
-    void visit(const Forall& expr) {
-      result = translate_forall(translator,expr,carrying_not);
-    }
+  Elaboration leave(const Node& n, Elaboration* es, std::size_t k) {
+    Translate_fn f {translator,n.carrying_not,es,k,scopes};
+    return visit(*n.expr, f);
+  }
 
-    void visit_type(const Type& expr) {
-      result = translate_type(translator,expr);
-    }
-    void visit(const Bool_type& expr) {
-      result = translate_type(translator,expr);
-    }
-    void visit(const Int_type& expr) {
-      result = translate_type(translator,expr);
-    }
-    void visit(const Kind_type& expr) {
-      result = translate_type(translator,expr);
-    }
+  Translator& translator;
+  std::stack<Factory_scope> scopes;
+};
 
-    Translator& translator;
-    Elaboration result;
-    bool carrying_not;
-  };
+} // namespace
 
-  V vis(*this,carrying_not);
-  expr.accept(vis);
-  return vis.result;
+Elaboration
+Translator::translate(const Expr& expr, bool carrying_not) {
+  Translate_walker w(*this);
+  return traverse(w, {&expr,carrying_not});
 }
 
 Elaboration
@@ -1,6 +1,7 @@
 
 #include <cctype>
 #include <iostream>
+#include <stdexcept>
 #include <unordered_map>
 
 #include "utility/Diagnostics.hpp"
@@ -105,11 +106,12 @@ symbol(Lexer& lex, const char* sym) {
 
 // Define a keyword table.
 using Keyword_table = std::unordered_map<String, Token_type> ;
-static Keyword_table keywords;
 
-void
-init_keywords() {
-  Keyword_table t {
+// Returns the keyword table. It is initialized on the first call, which
+// is safe even when several lexers are running on different threads.
+const Keyword_table&
+keywords() {
+  static const Keyword_table t {
     // Operator keywords
     {"and", And_tok},
     {"or", Or_tok},
@@ -123,20 +125,16 @@ init_keywords() {
     {"bool", Bool_tok},
     {"int", Int_tok},
   };
-  keywords.swap(t);
+  return t;
 }
 
 // Return the token type of the keyword str. If str is not a keyword,
 // then it must be an identifier.
 Token_type
 lookup_keyword(String str) {
-  // If the keyword table is empty, then populate it on the first pass.
-  if (keywords.empty())
-    init_keywords();
-
-  // Find the given keyword.
-  auto i = keywords.find(str);
-  if (i != keywords.end())
+  const Keyword_table& t = keywords();
+  auto i = t.find(str);
+  if (i != t.end())
     return i->second;
   else
     return Identifier_tok;
@@ -199,6 +197,24 @@ save_token(Lexer& lex, Token_type t, std::size_t n) {
   consume(lex, n);
 }
 
+// Save an n-character integer literal, along with its value. A literal
+// whose value cannot be represented is diagnosed and saved as an error
+// token, so that conversion never throws out of the lexer.
+inline void
+save_int_literal(Lexer& lex, std::size_t n) {
+  const char* first = &*lex.head;
+  try {
+    Integer value = Integer::from_digits(first, first + n);
+    lex.tokens.emplace_back(Int_literal_tok, String(first, n), lex.loc,
+                            std::move(value));
+  } catch (std::overflow_error&) {
+    error(lex.loc) << "integer literal '" << std::string(first, n)
+                   << "' is too large\n";
+    lex.tokens.emplace_back(Error_tok, String(first, n), lex.loc);
+  }
+  consume(lex, n);
+}
+
 // Save a 1-character token of the specified type.
 inline void
 save_unigraph(Lexer& lex, Token_type t) {
@@ -324,7 +340,7 @@ tokenize(Lexer& lex) {
     case '0': case '1': case '2': case '3': case '4':
     case '5': case '6': case '7': case '8': case '9': {
       std::size_t n = int_literal(lex);
-      save_token(lex, Int_literal_tok, n);
+      save_int_literal(lex, n);
       break;
     }
 
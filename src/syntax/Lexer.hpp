@@ -7,14 +7,15 @@
 
 namespace sarah {
 
-// The Lexer is responsible for the tokenization of an input file.
+// The Lexer is responsible for the tokenization of an input file. The
+// text is scanned in place, so it must outlive the lexer.
 struct Lexer {
   Lexer(const File& f)
     : loc(f), head(f.begin()), tail(f.end())
   { }
 
   Lexer(std::string& s)
-    : head(s.begin()), tail(s.end())
+    : head(s.data()), tail(s.data() + s.size())
   { }
 
   const Token_list& operator()();
@@ -22,8 +23,8 @@ struct Lexer {
   //const Token_list& tokenize_from_string(std::string& s);
 
   Location loc;
-  String::iterator head;
-  String::iterator tail;
+  File::const_iterator head;
+  File::const_iterator tail;
   Token_list tokens;
 };
 
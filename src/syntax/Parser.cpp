@@ -1,5 +1,6 @@
 
 #include <iostream>
+#include <vector>
 
 #include "utility/Diagnostics.hpp"
 #include "Parser.hpp"
@@ -113,36 +114,50 @@ template<Symbol Op, Production Sub>
     return nullptr;
   }
 
-// Parse a right-associative binary expression.
+// Parse a right-associative binary expression. The operands are parsed
+// in a loop and combined from the right, so a long chain does not
+// recurse.
 //
-//    right(op, self, sub) ::= sub [op this]
-template<Symbol Op, Production Self, Production Sub>
+//    right(op, sub) ::= sub [op right(op, sub)]
+template<Symbol Op, Production Sub>
   const Tree*
   parse_right(Parser& p) {
-    if (const Tree* l = Sub(p)) {
-      if (const Token* t = Op(p)) {
-        if (const Tree* r = parse_expected<Self>(p))
-          l = &p.make_binary(*t, *l, *r);
-        else
-          return nullptr;
+    std::vector<const Tree*> subs;
+    std::vector<const Token*> ops;
+    if (const Tree* l = Sub(p))
+      subs.push_back(l);
+    else
+      return nullptr;
+    while (const Token* t = Op(p)) {
+      if (const Tree* r = parse_expected<Sub>(p)) {
+        ops.push_back(t);
+        subs.push_back(r);
+      } else {
+        return nullptr;
       }
-      return l;
     }
-    return nullptr;
+    const Tree* r = subs.back();
+    for (std::size_t i = ops.size(); i-- > 0; )
+      r = &p.make_binary(*ops[i], *subs[i], *r);
+    return r;
   }
 
-// Parse a unary expression.
+// Parse a unary expression. A run of operators is parsed in a loop and
+// applied from the innermost.
 //
-//   unary(op, self, sub) ::= sub | op self
-template<Symbol Op, Production Self, Production Sub>
+//   unary(op, sub) ::= sub | op unary(op, sub)
+template<Symbol Op, Production Sub>
   const Tree*
   parse_unary(Parser& p) {
-    if (const Token* t = Op(p)) {
-      if (const Tree* n = parse_expected<Self>(p))
-        return &p.make_unary(*t, *n);
+    std::vector<const Token*> ops;
+    while (const Token* t = Op(p))
+      ops.push_back(t);
+    const Tree* n = ops.empty() ? Sub(p) : parse_expected<Sub>(p);
+    if (not n)
       return nullptr;
-    }
-    return Sub(p);
+    for (std::size_t i = ops.size(); i-- > 0; )
+      n = &p.make_unary(*ops[i], *n);
+    return n;
   }
 
 
@@ -279,10 +294,10 @@ parse_sign_op(Parser& p) {
 
 // Parse an arithmetic sign expression.
 //
-//     sign-expr ::= unary(sign-expr, primary-expr, sign-op)
+//     sign-expr ::= unary(sign-op, primary-expr)
 const Tree*
 parse_sign_expr(Parser& p) {
-  return parse_unary<parse_sign_op, parse_sign_expr, parse_primary_expr>(p);
+  return parse_unary<parse_sign_op, parse_primary_expr>(p);
 }
 
 // Parse a multiplicative operator.
@@ -385,9 +400,7 @@ parse_not_op(Parser& p) { return accept(p, Not_tok); }
 //     not-expr ::= unary(not-op, equality-expr)
 const Tree*
 parse_not_expr(Parser& p) {
-  return parse_unary<parse_not_op,
-                     parse_not_expr,
-                     parse_equality_expr>(p);
+  return parse_unary<parse_not_op, parse_equality_expr>(p);
 }
 
 // Parse a logical and operator.
@@ -429,9 +442,7 @@ parse_implication_op(Parser& p) { return accept(p, Imp_tok); }
 //    implication-expr ::= right(implication-op, logical_or_expr)
 const Tree*
 parse_implication_expr(Parser& p) {
-  return parse_right<parse_implication_op,
-                     parse_implication_expr,
-                     parse_or_expr>(p);
+  return parse_right<parse_implication_op, parse_or_expr>(p);
 }
 
 // Parse the if-and-only-if operator.
@@ -472,28 +483,29 @@ parse_quanitifier(Parser& p) {
     return nullptr;
 }
 
-// Parse a quantified expression.
-//
-//    quantified-expr ::= quantifier bind-expr '.' expr
-const Tree*
-parse_quantified_expr(Parser& p) {
-  if (const Token* q = parse_quanitifier(p))
-    if (const Tree* b = parse_expected<parse_bind_expr>(p))
-      if (expect(p, Dot_tok))
-        if (const Tree* e = parse_expr(p))
-          return &p.make_binary(*q, *b, *e);
-  return nullptr;
-}
-
-// Parse an expr.
+// Parse an expr. A run of quantifiers is parsed in a loop and applied
+// from the innermost, so nested quantifiers do not recurse.
 //
 //     expr ::= quantified-expr | iff-expression
+//
+//     quantified-expr ::= quantifier bind-expr '.' expr
 const Tree*
 parse_expr(Parser& p) {
-  if (const Tree* t = parse_quantified_expr(p))
-    return t;
-  else
-    return parse_iff_expr(p);
+  std::vector<const Token*> qs;
+  std::vector<const Tree*> bs;
+  while (const Token* q = parse_quanitifier(p)) {
+    const Tree* b = parse_expected<parse_bind_expr>(p);
+    if (not b or not expect(p, Dot_tok))
+      return nullptr;
+    qs.push_back(q);
+    bs.push_back(b);
+  }
+  const Tree* e = parse_iff_expr(p);
+  if (not e)
+    return nullptr;
+  for (std::size_t i = qs.size(); i-- > 0; )
+    e = &p.make_binary(*qs[i], *bs[i], *e);
+  return e;
 }
 
 // -------------------------------------------------------------------------- //
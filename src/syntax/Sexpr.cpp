@@ -1,6 +1,9 @@
 
 #include <iostream>
 
+#include "utility/Traversal.hpp"
+#include "utility/Utility.hpp"
+
 #include "Sexpr.hpp"
 #include "Tree.hpp"
 
@@ -8,31 +11,46 @@ namespace sarah {
 
 namespace {
 
-template<typename T>
-  void 
-  do_sexpr(std::ostream& os, const Structure<T>& t) {
-    os << sexpr(t.first());
+// Returns the operator of a unary or binary tree, or nullptr for trees
+// that are written without parentheses.
+const Token*
+op(const Tree& t) {
+  switch (t.tag) {
+  case Unary_tree_kind: return &as<Unary_tree>(t).op();
+  case Binary_tree_kind: return &as<Binary_tree>(t).op();
+  default: return nullptr;
+  }
+}
+
+// Writes a tree as its operator and operands in parentheses. Enclosing
+// parentheses in the source are not written.
+struct Sexpr_walker : Walker<const Tree*> {
+  Sexpr_walker(std::ostream& os)
+    : os(os) { }
+
+  void enter(const Tree* t, std::vector<const Tree*>& ts) {
+    if (const Terminal_tree* term = as<Terminal_tree>(t))
+      os << sexpr(term->token());
+    else if (const Token* tok = op(*t))
+      os << '(' << sexpr(*tok);
+    for (std::size_t i = 0; i < arity(*t); ++i)
+      ts.push_back(&operand(*t, i));
   }
 
-template<typename T1, typename T2>
-  void 
-  do_sexpr(std::ostream& os, const Structure<T1, T2>& t) {
-    os << '(' << sexpr(t.first())
-       << ' ' << sexpr(t.second()) << ')';
+  bool next(const Tree* t, std::size_t, const No_result*) {
+    if (op(*t))
+      os << ' ';
+    return true;
   }
 
-template<typename T1, typename T2, typename T3>
-  inline void 
-  do_sexpr(std::ostream& os, const Structure<T1, T2, T3>& t) {
-    os << '(' << sexpr(t.first())
-       << ' ' << sexpr(t.second()) 
-       << ' ' << sexpr(t.third()) << ')';
+  No_result leave(const Tree* t, No_result*, std::size_t) {
+    if (op(*t))
+      os << ')';
+    return {};
   }
 
-void
-do_sexpr(std::ostream& os, const Enclosed_tree& t) {
-  os << sexpr(t.arg());
-}
+  std::ostream& os;
+};
 
 } // namespace
 
@@ -45,17 +63,8 @@ to_sexpr(std::ostream& os, const Token& tok) {
 // Writes the tree t to an output stream.
 std::ostream&
 to_sexpr(std::ostream& os, const Tree& ast) {
-  struct V : Tree::Visitor {
-    V(std::ostream& os) : os(os) { }
-    void visit(const Enclosed_tree& t) { do_sexpr(os, t); }
-    void visit(const Terminal_tree& t) { do_sexpr(os, t); }
-    void visit(const Unary_tree& t) { do_sexpr(os, t); }
-    void visit(const Binary_tree& t) { do_sexpr(os, t); }
-    std::ostream& os;
-  };
-
-  V v(os);
-  ast.accept(v);
+  Sexpr_walker w(os);
+  traverse(w, &ast);
   return os;
 }
 
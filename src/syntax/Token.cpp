@@ -55,4 +55,17 @@ spelling(Token_type t)
 const char*
 spelling(const Token& t) { return t.spell.data(); }
 
+// A small value is copied, which costs nothing, so only a large one is
+// marked as taken.
+Integer
+take_value(const Token& t) {
+  if (t.taken)
+    return Integer::from_digits(t.spell.data(),
+                                t.spell.data() + t.spell.size());
+  if (t.value.is_small())
+    return t.value;
+  t.taken = true;
+  return std::move(t.value);
+}
+
 } // namespace sarah
@@ -6,6 +6,7 @@
 #include <iosfwd>
 
 #include "utility/String.hpp"
+#include "utility/Integer.hpp"
 #include "utility/Location.hpp"
 
 namespace sarah {
@@ -67,28 +68,39 @@ enum Token_type {
 ///       // Executed whe t.type != Error_tok
 struct Token {
   Token()
-    : type(Error_tok)
+    : type(Error_tok), taken(false)
   { }
 
   Token(Token_type t, Location l)
-    : type(t), loc(l)
+    : type(t), loc(l), taken(false)
   { }
 
   Token(Token_type t, String s, Location l)
-    : type(t), spell(s), loc(l)
+    : type(t), spell(s), loc(l), taken(false)
+  { }
+
+  Token(Token_type t, String s, Location l, Integer v)
+    : type(t), spell(s), loc(l), value(std::move(v)), taken(false)
   { }
 
   // Returns true for any non-error token.
   explicit operator bool() const { return type != Error_tok; }
 
-  Token_type type;
-  String     spell;
-  Location   loc;
+  Token_type      type;
+  String          spell;
+  Location        loc;
+  mutable Integer value; // The value of an integer literal
+  mutable bool    taken; // True when the value was moved out
 };
 
 const char* spelling(Token_type);
 const char* spelling(const Token&);
 
+// Returns the value of an integer literal. A large value is moved out of
+// the token, so that it is not copied into the expression that holds it.
+// Asking for it again converts the spelling anew.
+Integer take_value(const Token&);
+
 // Streamable
 template<typename T, typename C>
   inline std::basic_ostream<T, C>&
@@ -1,4 +1,8 @@
 
+#include <cassert>
+
+#include "utility/Utility.hpp"
+
 #include "Tree.hpp"
 
 namespace sarah {
@@ -23,5 +27,28 @@ Tree::Factory::make_binary(const Token& o, const Tree& l, const Tree& r) {
   return bins.make(o, l, r);
 }
 
+std::size_t
+arity(const Tree& t) {
+  switch (t.tag) {
+  case Enclosed_tree_kind: return 1;
+  case Terminal_tree_kind: return 0;
+  case Unary_tree_kind: return 1;
+  case Binary_tree_kind: return 2;
+  }
+  return 0;
+}
+
+const Tree&
+operand(const Tree& t, std::size_t i) {
+  assert(i < arity(t));
+  switch (t.tag) {
+  case Enclosed_tree_kind: return as<Enclosed_tree>(t).arg();
+  case Unary_tree_kind: return as<Unary_tree>(t).arg();
+  default: break;
+  }
+  const Binary_tree& b = as<Binary_tree>(t);
+  return i == 0 ? b.left() : b.right();
+}
+
 } // namespace sarah
 
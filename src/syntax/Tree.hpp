@@ -1,6 +1,7 @@
 #ifndef SARAH_TREE_HPP
 #define SARAH_TREE_HPP
 
+#include <cstddef>
 #include <list>
 #include <tuple>
 #include <iosfwd>
@@ -15,6 +16,38 @@ namespace sarah {
 // -------------------------------------------------------------------------- //
 // Trees
 
+struct Enclosed_tree;
+struct Terminal_tree;
+struct Unary_tree;
+struct Binary_tree;
+
+// Each class of tree has a distinct kind, stored in the tree so that its
+// class can be tested without dynamic_cast.
+enum Tree_kind : unsigned char {
+  Enclosed_tree_kind,
+  Terminal_tree_kind,
+  Unary_tree_kind,
+  Binary_tree_kind,
+};
+
+// The kind of each tree class.
+template<typename T>
+  struct Tree_kind_of;
+
+template<Tree_kind K>
+  struct Tree_kind_constant {
+    static constexpr Tree_kind value = K;
+  };
+
+template<> struct Tree_kind_of<Enclosed_tree>
+  : Tree_kind_constant<Enclosed_tree_kind> { };
+template<> struct Tree_kind_of<Terminal_tree>
+  : Tree_kind_constant<Terminal_tree_kind> { };
+template<> struct Tree_kind_of<Unary_tree>
+  : Tree_kind_constant<Unary_tree_kind> { };
+template<> struct Tree_kind_of<Binary_tree>
+  : Tree_kind_constant<Binary_tree_kind> { };
+
 // The Tree class is the base of all nodes in the parse tree.
 struct Tree { 
   struct Factory;
@@ -23,13 +56,26 @@ struct Tree {
   virtual ~Tree() { }
 
   virtual void accept(Visitor& v) const = 0;
+
+  // Every tree is a Tree.
+  static bool classof(const Tree&) { return true; }
+
+  // The kind of the tree, set by Tree_impl.
+  Tree_kind tag;
 };
 
 // Provides a default implementation of common facilities in the
 // AST Tree class.
 template<typename Derived>
   struct Tree_impl : Tree {
+    Tree_impl() { tag = Tree_kind_of<Derived>::value; }
+
     virtual void accept(Visitor& v) const;
+
+    // Returns true when t is a Derived.
+    static bool classof(const Tree& t) {
+      return t.tag == Tree_kind_of<Derived>::value;
+    }
   };
 
 
@@ -85,6 +131,13 @@ struct Tree::Factory {
   Basic_factory<Binary_tree> bins;
 };
 
+// Returns the number of operands of t. The tokens of a tree are not its
+// operands.
+std::size_t arity(const Tree& t);
+
+// Returns the ith operand of t.
+const Tree& operand(const Tree& t, std::size_t i);
+
 // -------------------------------------------------------------------------- //
 // Visitor
 
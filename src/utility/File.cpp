@@ -1,40 +1,96 @@
-
+#include <cerrno>
 #include <iostream>
-#include <fstream>
-#include <iterator>
-#include <memory>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "File.hpp"
 
 namespace sarah {
 
-// Read the contents of the spcified file, returning a string containing
-// its contents.
-std::string
-File::read(const std::string& path)
+namespace {
+
+// The size of the blocks in which unmapped files and streams are read.
+constexpr std::size_t block_size = 1 << 16;
+
+} // namespace
+
+File::File(std::istream& is)
+  : path(), map(nullptr), first(nullptr), last(nullptr) { read(is); }
+
+// A file that cannot be opened has no text.
+File::File(const std::string& p)
+  : path(p), map(nullptr), first(nullptr), last(nullptr)
 {
-  using namespace std;
+  int fd = ::open(p.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  if (not map_file(fd))
+    read(fd);
+  ::close(fd);
+}
 
-  fstream input(path, ios::in);
-  input.seekg(0, ios::end);
-  int size = input.tellg();
-  input.seekg(0, ios::beg);
+File::~File() {
+  if (map)
+    ::munmap(map, size());
+}
 
-  unique_ptr<char> buf(new char[size]);
-  input.read(buf.get(), size);
-  input.close();
+// Map the file, if it is a non-empty regular file, returning true when
+// it is mapped. The mapping outlives the descriptor. The text is scanned
+// from front to back, so the system is told to read ahead.
+bool
+File::map_file(int fd) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0 or not S_ISREG(st.st_mode) or st.st_size == 0)
+    return false;
+  std::size_t n = st.st_size;
+  void* p = ::mmap(nullptr, n, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED)
+    return false;
+  ::madvise(p, n, MADV_SEQUENTIAL);
+  map = p;
+  first = static_cast<const char*>(p);
+  last = first + n;
+  return true;
+}
 
-  return string(buf.get(), size);
+// Read the rest of the file into the buffer.
+void
+File::read(int fd) {
+  std::size_t n = 0;
+  while (true) {
+    buf.resize(n + block_size);
+    ssize_t k = ::read(fd, &buf[n], block_size);
+    if (k < 0 and errno == EINTR)
+      continue;
+    if (k <= 0)
+      break;
+    n += k;
+  }
+  buf.resize(n);
+  first = buf.data();
+  last = first + n;
 }
 
-// Read from the given input stream.
-std::string
+// Read the rest of the stream into the buffer. Blocks are taken from the
+// stream buffer directly, rather than a character at a time through the
+// stream.
+void
 File::read(std::istream& is) {
-  using namespace std;
-  is >> noskipws;
-  istream_iterator<char> iter = is;
-  istream_iterator<char> end;
-  return string(iter, end);  
+  std::streambuf* sb = is.rdbuf();
+  std::size_t n = 0;
+  while (true) {
+    buf.resize(n + block_size);
+    std::streamsize k = sb->sgetn(&buf[n], block_size);
+    if (k <= 0)
+      break;
+    n += k;
+  }
+  buf.resize(n);
+  first = buf.data();
+  last = first + n;
 }
 
-} // namespace sarah 
+} // namespace sarah
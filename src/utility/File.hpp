@@ -9,29 +9,44 @@ namespace sarah {
 // The File class represents the text of an opened file. The file is
 // opened and read as soon as it is initalized, and the text is retained
 // as long as the object lives.
+//
+// A regular file named by a path is mapped into memory rather than read,
+// so its text is not copied: the pages are read by the system as they
+// are scanned. Other files, and streams, are read into a buffer in large
+// blocks. Either way, the text is the range [begin(), end()).
 struct File {
-  using iterator = std::string::iterator;
-  using const_iterator = std::string::const_iterator;
+  using iterator = const char*;
+  using const_iterator = const char*;
 
-  File(std::istream& is)
-    : path(), text(read(is)) { }
+  File(std::istream& is);
+  File(const std::string& p);
+  ~File();
 
-  File(const std::string& p)
-    : path(p), text(read(p)) { }
+  File(const File&) = delete;
+  File& operator=(const File&) = delete;
 
   // Text iterators
-  iterator       begin()       { return text.begin(); }
-  const_iterator begin() const { return text.begin(); }
+  const_iterator begin() const { return first; }
+  const_iterator end() const { return last; }
 
-  iterator       end()       { return text.end(); }
-  const_iterator end() const { return text.end(); }
+  // Returns the text of the file.
+  const char* data() const { return first; }
+  std::size_t size() const { return last - first; }
+
+  // Returns true when the text is mapped from the file.
+  bool mapped() const { return map; }
 
   std::string path;
-  std::string text;
 
 private:
-  static std::string read(const std::string&);
-  static std::string read(std::istream& is);
+  void read(std::istream&);
+  void read(int);
+  bool map_file(int);
+
+  std::string buf; // The text, when it is not mapped
+  void* map;
+  const char* first;
+  const char* last;
 };
 
 } // namespace sarah
@@ -0,0 +1,213 @@
+
+#include <utility>
+
+#include "Gcd.hpp"
+
+namespace sarah {
+
+namespace {
+
+using Word = Integer::uword;
+
+constexpr Word max_word = ~Word(0) >> 1;
+
+inline Word
+magnitude(Integer::word n) { return n < 0 ? -(Word)n : n; }
+
+// Returns the number of trailing zeros in a non-zero word.
+inline int
+ctz(unsigned long n) { return __builtin_ctzl(n); }
+
+#ifdef __SIZEOF_INT128__
+inline int
+ctz(unsigned __int128 n) {
+  unsigned long lo = n;
+  return lo ? ctz(lo) : 64 + ctz((unsigned long)(n >> 64));
+}
+#endif
+
+// Sets z to the value of m.
+inline void
+set_word(mpz_t z, unsigned long m) { mpz_set_ui(z, m); }
+
+#ifdef __SIZEOF_INT128__
+inline void
+set_word(mpz_t z, unsigned __int128 m) {
+  unsigned long limbs[2] = {(unsigned long)m, (unsigned long)(m >> 64)};
+  mpz_import(z, 2, -1, sizeof(unsigned long), 0, 0, limbs);
+}
+#endif
+
+// Returns the gcd of two odd words, or the odd word b when a is 0.
+inline Word
+odd_gcd(Word a, Word b) {
+  if (a == 0)
+    return b;
+  while (a != b) {
+    if (a > b)
+      std::swap(a, b);
+    b -= a;
+    b >>= ctz(b);
+  }
+  return a;
+}
+
+// Binary gcd of two words.
+inline Word
+word_gcd(Word a, Word b) {
+  if (a == 0)
+    return b;
+  if (b == 0)
+    return a;
+  int k = ctz(a | b);
+  return odd_gcd(a >> ctz(a), b >> ctz(b)) << k;
+}
+
+// Returns the non-negative integer with magnitude m.
+Integer
+make_integer(Word m) {
+  if (m <= max_word)
+    return Integer::from_word(m);
+  mpz_t z;
+  mpz_init(z);
+  set_word(z, m);
+  Integer r(z);
+  mpz_clear(z);
+  return r;
+}
+
+bool
+all_small(const Integer* a, std::size_t n) {
+  bool small = true;
+  for (std::size_t i = 0; i < n; ++i)
+    small &= a[i].is_small();
+  return small;
+}
+
+// The gcd of small integers. The power of two common to every entry is
+// given by the trailing zeros of their bitwise or, which is a simple
+// reduction. The odd parts are then combined with binary gcd, stopping
+// as soon as the result is 1.
+Word
+small_gcd(const Integer* a, std::size_t n) {
+  Word any = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    any |= magnitude(a[i].small_value());
+  if (any == 0)
+    return 0;
+  int k = ctz(any);
+
+  Word g = 0;
+  for (std::size_t i = 0; i < n and g != 1; ++i) {
+    if (Word m = magnitude(a[i].small_value()))
+      g = odd_gcd(g, m >> ctz(m));
+  }
+  return g << k;
+}
+
+// Accumulate the gcd of a into g using GMP.
+void
+big_gcd(mpz_t g, const Integer* a, std::size_t n) {
+  for (std::size_t i = 0; i < n and mpz_cmp_ui(g, 1) != 0; ++i)
+    mpz_gcd(g, g, Integer_view(a[i]).get());
+}
+
+// Accumulate the lcm of a into l using GMP.
+void
+big_lcm(mpz_t l, const Integer* a, std::size_t n) {
+  for (std::size_t i = 0; i < n and mpz_sgn(l) != 0; ++i)
+    mpz_lcm(l, l, Integer_view(a[i]).get());
+}
+
+} // namespace
+
+Integer
+gcd(const Integer& a, const Integer& b) {
+  if (a.is_small() and b.is_small())
+    return make_integer(word_gcd(magnitude(a.small_value()),
+                                 magnitude(b.small_value())));
+  mpz_t g;
+  mpz_init(g);
+  mpz_gcd(g, Integer_view(a).get(), Integer_view(b).get());
+  Integer r(g);
+  mpz_clear(g);
+  return r;
+}
+
+Integer
+lcm(const Integer& a, const Integer& b) {
+  if (a.is_small() and b.is_small()) {
+    Word x = magnitude(a.small_value());
+    Word y = magnitude(b.small_value());
+    if (x == 0 or y == 0)
+      return Integer(0);
+    Word l;
+    if (not __builtin_mul_overflow(x / word_gcd(x, y), y, &l))
+      return make_integer(l);
+  }
+  mpz_t l;
+  mpz_init(l);
+  mpz_lcm(l, Integer_view(a).get(), Integer_view(b).get());
+  Integer r(l);
+  mpz_clear(l);
+  return r;
+}
+
+Integer
+gcd(const Integer* a, std::size_t n) {
+  if (all_small(a, n))
+    return make_integer(small_gcd(a, n));
+  mpz_t g;
+  mpz_init(g);
+  big_gcd(g, a, n);
+  Integer r(g);
+  mpz_clear(g);
+  return r;
+}
+
+// The lcm is accumulated in a machine word until it overflows or a large
+// entry is found. The remaining entries are handled by GMP.
+Integer
+lcm(const Integer* a, std::size_t n) {
+  Word l = 1;
+  std::size_t i = 0;
+  for (; i < n and a[i].is_small(); ++i) {
+    Word m = magnitude(a[i].small_value());
+    if (m == 0)
+      return Integer(0);
+    Word r;
+    if (__builtin_mul_overflow(l / word_gcd(l, m), m, &r))
+      break;
+    l = r;
+  }
+  if (i == n)
+    return make_integer(l);
+
+  mpz_t z;
+  mpz_init(z);
+  set_word(z, l);
+  big_lcm(z, a + i, n - i);
+  Integer r(z);
+  mpz_clear(z);
+  return r;
+}
+
+// When the entries and their gcd are small, each entry is divided exactly
+// in a machine word. Otherwise, the division is done by Integer.
+Integer
+divide_content(Integer* a, std::size_t n) {
+  Integer g = gcd(a, n);
+  if (g == Integer(0) or g == Integer(1))
+    return g;
+  if (g.is_small() and all_small(a, n)) {
+    Integer::word d = g.small_value();
+    for (std::size_t i = 0; i < n; ++i)
+      a[i] = Integer::from_word(a[i].small_value() / d);
+  } else {
+    for (std::size_t i = 0; i < n; ++i)
+      a[i] /= g;
+  }
+  return g;
+}
+
+} // namespace sarah
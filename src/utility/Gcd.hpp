@@ -0,0 +1,33 @@
+#ifndef SARAH_GCD_HPP
+#define SARAH_GCD_HPP
+
+#include <cstddef>
+
+#include "Integer.hpp"
+
+namespace sarah {
+
+// Greatest common divisors and least common multiples.
+//
+// The batch operations work on contiguous arrays of coefficients, such as
+// the coefficients of a linear term or the moduli of a set of divisibility
+// constraints. When every entry is small, they run entirely on machine
+// words; otherwise they fall back to GMP. Results are never negative.
+
+Integer gcd(const Integer&, const Integer&);
+Integer lcm(const Integer&, const Integer&);
+
+// Returns the gcd of the n integers in a. The gcd of an empty array is 0.
+Integer gcd(const Integer* a, std::size_t n);
+
+// Returns the lcm of the n integers in a. The lcm of an empty array is 1,
+// and the lcm of any array containing 0 is 0.
+Integer lcm(const Integer* a, std::size_t n);
+
+// Divides each of the n integers in a by their gcd, and returns that gcd.
+// The array is not modified if its gcd is 0 or 1.
+Integer divide_content(Integer* a, std::size_t n);
+
+} // namespace sarah
+
+#endif
@@ -1,5 +1,18 @@
 
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
 #include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <sys/mman.h>
 
 #include "Integer.hpp"
 
@@ -7,51 +20,534 @@ namespace sarah {
 
 // NOTE: GMP does not optimize for default-intialized values. That is
 // mpz_init allocates memory, which will result in an inefficient move
-// implementation. 
+// implementation. Small values avoid GMP entirely, and a value is only
+// promoted when an operation on it overflows.
+
+namespace {
+
+using Policy = Integer_policy;
+using word = Integer::word;
+using uword = Integer::uword;
+
+constexpr word max_word = word(~uword(0) >> 1);
+constexpr word min_word = -max_word - 1;
+
+// The number of decimal digits that always fit in a word, which is the
+// floor of log10(2) times the number of value bits.
+constexpr std::size_t word_digits =
+  (sizeof(word) * CHAR_BIT - 1) * 30103 / 100000;
+
+inline uword
+magnitude(word n) { return n < 0 ? -(uword)n : n; }
+
+// Floor division of small values. The caller guarantees that b is
+// non-zero and that the quotient does not overflow.
+inline word
+floor_div(word a, word b) {
+  word q = a / b;
+  if ((a % b != 0) and ((a < 0) != (b < 0)))
+    --q;
+  return q;
+}
+
+// The remainder of floor division. The caller guarantees that b is
+// non-zero.
+inline word
+floor_rem(word a, word b) {
+  if (b == -1)
+    return 0;
+  word r = a % b;
+  if (r != 0 and ((r < 0) != (b < 0)))
+    r += b;
+  return r;
+}
+
+// Returns the number of significant bits in a non-zero word.
+inline int
+width(unsigned long n) { return sizeof(n) * CHAR_BIT - __builtin_clzl(n); }
+
+#ifdef __SIZEOF_INT128__
+inline int
+width(unsigned __int128 n) {
+  unsigned long hi = n >> 64;
+  return hi ? 64 + width(hi) : width((unsigned long)n);
+}
+#endif
+
+// Stores the value of the GMP integer z in n, returning false if it does
+// not fit.
+inline bool
+get_word(const mpz_t& z, long& n) {
+  if (not mpz_fits_slong_p(z))
+    return false;
+  n = mpz_get_si(z);
+  return true;
+}
+
+#ifdef __SIZEOF_INT128__
+inline bool
+get_word(const mpz_t& z, __int128& n) {
+  if (mpz_sizeinbase(z, 2) > 128)
+    return false;
+  unsigned long limbs[2] = {0, 0};
+  mpz_export(limbs, nullptr, -1, sizeof(unsigned long), 0, 0, z);
+  unsigned __int128 m = ((unsigned __int128)limbs[1] << 64) | limbs[0];
+  if (mpz_sgn(z) < 0) {
+    if (m > (unsigned __int128)max_word + 1)
+      return false;
+    n = -__int128(m - 1) - 1;
+  } else {
+    if (m > (unsigned __int128)max_word)
+      return false;
+    n = m;
+  }
+  return true;
+}
+#endif
+
+// -------------------------------------------------------------------------- //
+// GMP memory hooks
+//
+// The hooks are installed when the first Integer_arena is created. Memory
+// that is not in the arena region was allocated with malloc, either by
+// these hooks or by GMP's default allocator.
+
+// The limbs of every arena come from one region of address space, so
+// whether memory belongs to an arena is decided by its address alone,
+// without a lock. The region is reserved when the first arena is created;
+// its pages are committed as they are touched, and returned to the system
+// when an arena releases them. If no region can be reserved, arenas take
+// their limbs from malloc.
+std::atomic<char*> region(nullptr);
+std::size_t region_size = 0;
+
+// Spans of the region are handed out to arenas from its unused end, or
+// from the spans released by destroyed arenas, under spans_lock. Arenas
+// take spans only when they fill the last one, so the lock is rare.
+constexpr std::size_t span_size = std::size_t(1) << 16;
+std::mutex spans_lock;
+std::size_t region_used = 0;
+std::vector<std::pair<char*, std::size_t>> free_spans;
+
+void
+reserve_region() {
+  for (std::size_t n = std::size_t(1) << 36; n >= span_size; n /= 2) {
+    void* p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p != MAP_FAILED) {
+      region_size = n;
+      region.store(static_cast<char*>(p), std::memory_order_release);
+      return;
+    }
+  }
+}
 
-Integer::Integer() { mpz_init(value); }
+// Returns a span of at least n bytes, and sets n to its size, or returns
+// nullptr when the region is exhausted.
+char*
+acquire_span(std::size_t& n) {
+  n = (n + span_size - 1) / span_size * span_size;
+  std::lock_guard<std::mutex> lock(spans_lock);
+  for (auto i = free_spans.begin(); i != free_spans.end(); ++i)
+    if (i->second >= n) {
+      char* p = i->first;
+      n = i->second;
+      free_spans.erase(i);
+      return p;
+    }
+  char* r = region.load(std::memory_order_relaxed);
+  if (not r or region_size - region_used < n)
+    return nullptr;
+  char* p = r + region_used;
+  region_used += n;
+  return p;
+}
+
+void
+release_span(char* p, std::size_t n) {
+  ::madvise(p, n, MADV_DONTNEED);
+  std::lock_guard<std::mutex> lock(spans_lock);
+  free_spans.emplace_back(p, n);
+}
+
+// Returns true when p was allocated from an arena.
+inline bool
+arena_owns(void* p) {
+  char* r = region.load(std::memory_order_acquire);
+  return r and std::size_t(static_cast<char*>(p) - r) < region_size;
+}
+
+// The arena supplying new limbs on this thread, if any.
+thread_local Integer_arena* used_arena = nullptr;
 
-Integer::Integer(const Integer& x) {
-  mpz_init_set(value, x.value); 
+void*
+allocate_limbs(std::size_t n) {
+  if (used_arena)
+    if (void* p = used_arena->allocate(n))
+      return p;
+  if (void* p = std::malloc(n))
+    return p;
+  throw std::bad_alloc();
+}
+
+// Limbs reallocated from an arena move to the allocator in use on this
+// thread, since the arena may be in use on another.
+void*
+reallocate_limbs(void* p, std::size_t old, std::size_t n) {
+  if (arena_owns(p)) {
+    void* q = allocate_limbs(n);
+    std::memcpy(q, p, old < n ? old : n);
+    return q;
+  }
+  if (void* q = std::realloc(p, n))
+    return q;
+  throw std::bad_alloc();
+}
+
+void
+free_limbs(void* p, std::size_t) {
+  if (not arena_owns(p))
+    std::free(p);
+}
+
+void
+install_hooks() {
+  static bool installed = [] {
+    reserve_region();
+    mp_set_memory_functions(allocate_limbs, reallocate_limbs, free_limbs);
+    return true;
+  }();
+  (void)installed;
+}
+
+} // namespace
+
+// -------------------------------------------------------------------------- //
+// Integer arena
+
+Integer_arena::Integer_arena()
+  : cur(nullptr), last(nullptr), reserved(0) { install_hooks(); }
+
+// The spans are returned to the region, on whichever thread this is.
+Integer_arena::~Integer_arena() {
+  assert(used_arena != this);
+  for (const Span& s : spans)
+    release_span(s.first, s.second);
+}
+
+// Limbs are aligned as malloc aligns them. A request that does not fit in
+// the current span starts a new one, large enough for it.
+void*
+Integer_arena::allocate(std::size_t n) {
+  const std::size_t align = alignof(std::max_align_t);
+  n = (n + align - 1) / align * align;
+  if (std::size_t(last - cur) < n) {
+    std::size_t k = n < span_size ? span_size : n;
+    char* p = acquire_span(k);
+    if (not p)
+      return nullptr;
+    spans.emplace_back(p, k);
+    reserved += k;
+    cur = p;
+    last = p + k;
+  }
+  void* p = cur;
+  cur += n;
+  return p;
+}
+
+Integer_arena_scope::Integer_arena_scope(Integer_arena& a)
+  : prev(used_arena) { used_arena = &a; }
+
+Integer_arena_scope::~Integer_arena_scope() { used_arena = prev; }
+
+// -------------------------------------------------------------------------- //
+// Integer view
+
+Integer_view::Integer_view(const Integer& x) {
+  if (x.is_small())
+    init(x.small_value());
+  else
+    ptr = x.big_value();
+}
+
+Integer_view::Integer_view(Integer::word n) { init(n); }
+
+// Copy the magnitude of n into limbs, least significant first.
+void
+Integer_view::init(Integer::word n) {
+  uword m = magnitude(n);
+  mp_size_t k = 0;
+  while (m != 0) {
+    limbs[k++] = mp_limb_t(m);
+    m >>= GMP_NUMB_BITS - 1;
+    m >>= 1;
+  }
+  ptr = mpz_roinit_n(view, limbs, n < 0 ? -k : k);
+}
+
+// -------------------------------------------------------------------------- //
+// Integer
+
+Integer::Integer()
+  : num(0), big(false) {
+  if (not Policy::words) {
+    mpz_init(value);
+    big = true;
+  }
+}
+
+Integer::Integer(const Integer& x)
+  : big(x.big) {
+  if (big)
+    mpz_init_set(value, x.value);
+  else
+    num = x.num;
 }
 
 Integer&
 Integer::operator=(const Integer& x) {
   if (this != &x) {
-    mpz_clear(value);
-    mpz_set(value, x.value);
+    if (not x.big) {
+      if (big)
+        mpz_clear(value);
+      num = x.num;
+      big = false;
+    } else if (big) {
+      mpz_set(value, x.value);
+    } else {
+      mpz_init_set(value, x.value);
+      big = true;
+    }
+  }
+  return *this;
+}
+
+// Take the value of x, leaving x with the value 0. A big value is
+// transferred without copying its limbs.
+Integer::Integer(Integer&& x) noexcept
+  : big(x.big) {
+  if (big)
+    *value = *x.value;
+  else
+    num = x.num;
+  x.reset();
+}
+
+Integer&
+Integer::operator=(Integer&& x) noexcept {
+  if (this != &x) {
+    if (big)
+      mpz_clear(value);
+    big = x.big;
+    if (big)
+      *value = *x.value;
+    else
+      num = x.num;
+    x.reset();
   }
   return *this;
 }
 
+// Leave a moved-from integer with the value 0, in the representation
+// required by the policy. This does not free x's limbs, which now belong
+// to another integer. Initializing a GMP integer does not allocate.
+void
+Integer::reset() noexcept {
+  if (Policy::words) {
+    num = 0;
+    big = false;
+  } else {
+    mpz_init(value);
+    big = true;
+  }
+}
+
 // Construct an integer with the value n.
-Integer::Integer(long n) { mpz_init_set_si(value, n); }
+Integer::Integer(long n)
+  : num(n), big(false) {
+  if (not Policy::words) {
+    mpz_init_set_si(value, n);
+    big = true;
+  }
+}
+
+Integer
+Integer::from_word(word n) {
+  Integer r;
+  if (Policy::words) {
+    r.num = n;
+  } else {
+    mpz_set(r.value, Integer_view(n).get());
+  }
+  return r;
+}
+
+// Short literals are accumulated in a word. The digits of longer ones
+// are converted by GMP into limbs reserved for the largest value with
+// that many digits.
+Integer
+Integer::from_digits(const char* first, const char* last) {
+  while (last - first > 1 and *first == '0')
+    ++first;
+  std::size_t n = last - first;
+  if (n <= word_digits) {
+    word v = 0;
+    for (const char* p = first; p != last; ++p)
+      v = v * 10 + (*p - '0');
+    return from_word(v);
+  }
+
+  // The digits are converted in a buffer that is reused by every call on
+  // the thread, and the limbs are allocated once, at their full size.
+  static thread_local std::vector<unsigned char> digits;
+  if (digits.size() < n)
+    digits.resize(n);
+  for (std::size_t i = 0; i < n; ++i)
+    digits[i] = first[i] - '0';
+  std::size_t bits = n * 10 / 3 + 1;
+  mp_size_t limbs = bits / GMP_NUMB_BITS + 2;
+
+  Integer r;
+  if (r.big)
+    mpz_realloc2(r.value, limbs * GMP_NUMB_BITS);
+  else
+    mpz_init2(r.value, limbs * GMP_NUMB_BITS);
+  r.big = true;
+  mp_limb_t* rp = mpz_limbs_write(r.value, limbs);
+  mpz_limbs_finish(r.value, mpn_set_str(rp, digits.data(), n, 10));
+  r.check();
+  return r;
+}
+
+// Construct an integer with the value of the GMP integer n.
+Integer::Integer(const mpz_t& n)
+  : big(true) {
+  mpz_init_set(value, n);
+  narrow();
+}
 
 // Consruct an integer with the value in s in base b. Behavior is undefined
 // if s does not represent an integer in base b.
-Integer::Integer(String s, int b) { 
-  if (mpz_init_set_str(value, s.data(), b) == -1)
+//
+// Spellings that fit in a long are converted without GMP. All others,
+// including those that are invalid, are handed to GMP.
+Integer::Integer(String s, int b)
+  : big(false) {
+  const char* str = s.data();
+  if (Policy::words and b >= 2 and b <= 10
+                    and (*str == '-' or std::isdigit(*str))) {
+    char* end;
+    errno = 0;
+    long n = std::strtol(str, &end, b);
+    if (errno == 0 and *end == 0 and end != str) {
+      num = n;
+      return;
+    }
+  }
+  if (mpz_init_set_str(value, str, b) == -1) {
+    mpz_clear(value);
     throw std::runtime_error("invalid integer representation");
+  }
+  big = true;
+  narrow();
 }
 
-Integer::~Integer() { mpz_clear(value); }
+Integer::~Integer() {
+  if (big)
+    mpz_clear(value);
+}
+
+// Move the small value into a GMP integer.
+void
+Integer::promote() {
+  if (not big) {
+    Integer_view v(num);
+    mpz_init_set(value, v.get());
+    big = true;
+  }
+}
 
+// Move a GMP value that fits in a word back inline.
+void
+Integer::demote() {
+  word n;
+  if (Policy::words and big and get_word(value, n)) {
+    mpz_clear(value);
+    num = n;
+    big = false;
+  }
+}
 
-Integer& 
+// Called after every operation that produces a GMP value. The result is
+// moved inline if it fits. Under a checked policy, a result that does not
+// fit is an error.
+void
+Integer::check() {
+  demote();
+  if (Policy::checked and big)
+    throw std::overflow_error("integer overflow");
+}
+
+// Like check, but for constructors. The value is released before
+// throwing since the destructor will not run.
+void
+Integer::narrow() {
+  demote();
+  if (Policy::checked and big) {
+    mpz_clear(value);
+    throw std::overflow_error("integer overflow");
+  }
+}
+
+const mpz_t&
+Integer::big_value() const {
+  assert(big);
+  return value;
+}
+
+Integer&
 Integer::operator+=(const Integer& x) {
-  mpz_add(value, value, x.value);
+  if (not big and not x.big) {
+    word r;
+    if (not __builtin_add_overflow(num, x.num, &r)) {
+      num = r;
+      return *this;
+    }
+  }
+  promote();
+  mpz_add(value, value, Integer_view(x).get());
+  check();
   return *this;
 }
 
-Integer& 
+Integer&
 Integer::operator-=(const Integer& x) {
-  mpz_sub(value, value, x.value);
+  if (not big and not x.big) {
+    word r;
+    if (not __builtin_sub_overflow(num, x.num, &r)) {
+      num = r;
+      return *this;
+    }
+  }
+  promote();
+  mpz_sub(value, value, Integer_view(x).get());
+  check();
   return *this;
 }
 
-Integer& 
+Integer&
 Integer::operator*=(const Integer& x) {
-  mpz_mul(value, value, x.value);
+  if (not big and not x.big) {
+    word r;
+    if (not __builtin_mul_overflow(num, x.num, &r)) {
+      num = r;
+      return *this;
+    }
+  }
+  promote();
+  mpz_mul(value, value, Integer_view(x).get());
+  check();
   return *this;
 }
 
@@ -59,36 +555,147 @@ Integer::operator*=(const Integer& x) {
 // floor division. A discussion of alternatives can be found in the paper,
 // "The Euclidean definition of the functions div and mod" by Raymond T.
 // Boute (http://dl.acm.org/citation.cfm?id=128862).
-Integer& 
+//
+// Division by zero and the single overflowing quotient (the least word
+// divided by -1) are handled by GMP.
+Integer&
 Integer::operator/=(const Integer& x) {
-  mpz_fdiv_q(value, value, x.value);
+  if (not big and not x.big and x.num != 0) {
+    if (not (num == min_word and x.num == -1)) {
+      num = floor_div(num, x.num);
+      return *this;
+    }
+  }
+  promote();
+  mpz_fdiv_q(value, value, Integer_view(x).get());
+  check();
   return *this;
 }
 
 // Compute the remainder of the division of this value by x. Integer division
 // is implemented as floor division. See the notes on operator/= for more
 // discussion.
-Integer& 
+Integer&
 Integer::operator%=(const Integer& x) {
-  mpz_fdiv_r(value, value, x.value);
+  if (not big and not x.big and x.num != 0) {
+    num = floor_rem(num, x.num);
+    return *this;
+  }
+  promote();
+  mpz_fdiv_r(value, value, Integer_view(x).get());
+  check();
   return *this;
 }
 
 // Returns true when the two integers have the same value.
 bool
 operator==(const Integer& a, const Integer& b) {
-  return mpz_cmp(a.data(), b.data()) == 0;
+  if (a.is_small() and b.is_small())
+    return a.small_value() == b.small_value();
+  return mpz_cmp(Integer_view(a).get(), Integer_view(b).get()) == 0;
 }
 
 // Returns true when a is less than b.
 bool
 operator<(const Integer& a, const Integer& b) {
-  return mpz_cmp(a.data(), b.data()) < 0;
+  if (a.is_small() and b.is_small())
+    return a.small_value() < b.small_value();
+  return mpz_cmp(Integer_view(a).get(), Integer_view(b).get()) < 0;
+}
+
+// A value that fits in a word is hashed as a word, even when it is held
+// by GMP. Otherwise, the limbs and the sign are combined.
+std::size_t
+hash(const Integer& n) {
+  word w;
+  if (n.is_small()) {
+    w = n.small_value();
+  } else if (not get_word(n.big_value(), w)) {
+    const mpz_t& z = n.big_value();
+    std::size_t h = mpz_sgn(z);
+    for (std::size_t i = 0; i < mpz_size(z); ++i)
+      h = h * 1099511628211ull ^ mpz_getlimbn(z, i);
+    return h;
+  }
+  uword m = w;
+  return std::size_t(m ^ (m >> 63 >> 1)) * 0x9e3779b97f4a7c15ull;
 }
 
-// Returns the number of bits in the integer representation.
+// Returns the number of bits in the integer representation. As with
+// GMP, the number of bits in 0 is 1.
 std::size_t
-Integer::bits() const { return mpz_sizeinbase(value, 2); }
+Integer::bits() const {
+  if (big)
+    return mpz_sizeinbase(value, 2);
+  if (num == 0)
+    return 1;
+  return width(magnitude(num));
+}
+
+// Pairs of decimal digits, for converting two digits per division.
+static const char digit_pairs[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
 
+// Writes n in the given base, backwards from last.
+char*
+format_small(char* last, Integer::word n, int base) {
+  uword mag = magnitude(n);
+  char* p = last;
+  if (base == 10) {
+    while (mag >= 100) {
+      const char* d = digit_pairs + 2 * int(mag % 100);
+      mag /= 100;
+      *--p = d[1];
+      *--p = d[0];
+    }
+    if (mag >= 10) {
+      const char* d = digit_pairs + 2 * int(mag);
+      *--p = d[1];
+      *--p = d[0];
+    } else {
+      *--p = char('0' + int(mag));
+    }
+  } else {
+    do {
+      *--p = "0123456789abcdef"[int(mag % base)];
+      mag /= base;
+    } while (mag != 0);
+  }
+  if (n < 0)
+    *--p = '-';
+  return p;
+}
+
+const char*
+format_large(const Integer& n, int base) {
+  static thread_local std::vector<char> buf;
+  std::size_t k = mpz_sizeinbase(n.big_value(), base) + 2;
+  if (buf.size() < k)
+    buf.resize(k);
+  return mpz_get_str(buf.data(), base, n.big_value());
+}
+
+void
+write(Output_buffer& buf, const Integer& n, int base) {
+  if (n.is_small()) {
+    char tmp[small_digits];
+    char* last = tmp + small_digits;
+    char* first = format_small(last, n.small_value(), base);
+    buf.put(first, last - first);
+    return;
+  }
+  char* p = buf.reserve(mpz_sizeinbase(n.big_value(), base) + 2);
+  mpz_get_str(p, base, n.big_value());
+  buf.advance(p + std::strlen(p));
+}
 
 } // namespace sarah
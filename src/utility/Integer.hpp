@@ -1,19 +1,91 @@
-
 #ifndef SARAH_INTEGER_HPP
 #define SARAH_INTEGER_HPP
 
+#include <cstddef>
+#include <utility>
+#include <vector>
+
 #include <gmp.h>
 
 #include "String.hpp"
-#include "Memory.hpp"
+
+// Integer backends. The backend is chosen at build time by defining
+// SARAH_INTEGER_BACKEND to one of these values (see the top-level
+// CMakeLists.txt).
+#define SARAH_INTEGER_HYBRID 0 // Machine words, promoted to GMP on overflow
+#define SARAH_INTEGER_GMP    1 // GMP only
+#define SARAH_INTEGER_INT64  2 // Checked 64-bit words
+#define SARAH_INTEGER_INT128 3 // Checked 128-bit words
+
+#ifndef SARAH_INTEGER_BACKEND
+#  define SARAH_INTEGER_BACKEND SARAH_INTEGER_HYBRID
+#endif
 
 namespace sarah {
 
+// An integer policy describes the representation of Integer values.
+//
+//   word     the signed type of values stored inline
+//   uword    the unsigned counterpart of word
+//   words    true when values that fit in a word are stored inline
+//   checked  true when a result that does not fit in a word is an
+//            error, rather than being promoted to GMP
+struct Hybrid_policy {
+  using word = long;
+  using uword = unsigned long;
+  static constexpr bool words = true;
+  static constexpr bool checked = false;
+};
+
+struct Gmp_policy {
+  using word = long;
+  using uword = unsigned long;
+  static constexpr bool words = false;
+  static constexpr bool checked = false;
+};
+
+struct Int64_policy {
+  using word = long;
+  using uword = unsigned long;
+  static constexpr bool words = true;
+  static constexpr bool checked = true;
+};
+
+#ifdef __SIZEOF_INT128__
+struct Int128_policy {
+  using word = __int128;
+  using uword = unsigned __int128;
+  static constexpr bool words = true;
+  static constexpr bool checked = true;
+};
+#endif
+
+#if SARAH_INTEGER_BACKEND == SARAH_INTEGER_HYBRID
+using Integer_policy = Hybrid_policy;
+#elif SARAH_INTEGER_BACKEND == SARAH_INTEGER_GMP
+using Integer_policy = Gmp_policy;
+#elif SARAH_INTEGER_BACKEND == SARAH_INTEGER_INT64
+using Integer_policy = Int64_policy;
+#elif SARAH_INTEGER_BACKEND == SARAH_INTEGER_INT128
+using Integer_policy = Int128_policy;
+#else
+#  error "unknown integer backend"
+#endif
+
 // The Integer class represents arbitrary integer values.
 //
-// \todo GMP is not a particularly efficient implementation.
+// Values that fit in a machine word are stored inline and manipulated
+// with overflow-checked arithmetic. An operation that overflows promotes
+// the value to a GMP integer, so small values never allocate.
+//
+// The representation is determined by the Integer_policy. With checked
+// policies, an operation whose result does not fit in a word throws
+// std::overflow_error. With the GMP policy, every value is a GMP integer.
 class Integer {
 public:
+  using word = Integer_policy::word;
+  using uword = Integer_policy::uword;
+
   // Default constructor
   Integer();
 
@@ -21,9 +93,21 @@ public:
   Integer(const Integer&);
   Integer& operator=(const Integer&);
 
+  // Move semantics
+  Integer(Integer&&) noexcept;
+  Integer& operator=(Integer&&) noexcept;
+
   // Value initialization
   Integer(long);
   Integer(String, int = 10);
+  explicit Integer(const mpz_t&);
+
+  // Returns an integer with the value n.
+  static Integer from_word(word n);
+
+  // Returns the integer whose decimal digits are in [first, last). The
+  // range must be non-empty and contain only the characters 0-9.
+  static Integer from_digits(const char* first, const char* last);
 
   // Destructor
   ~Integer();
@@ -38,20 +122,115 @@ public:
   // Observers
   std::size_t bits() const;
 
-  const mpz_t& data() const { return value; }
-  
+  // Returns true when the value is stored inline.
+  bool is_small() const { return not big; }
+
+  // Returns the inline value. Behavior is undefined if the value
+  // is not small.
+  word small_value() const { return num; }
+
+  // Returns the GMP representation of the value. Behavior is undefined
+  // if the value is small; an Integer_view reads values of either kind.
+  const mpz_t& big_value() const;
+
+private:
+  void promote();
+  void demote();
+  void check();
+  void narrow();
+  void reset() noexcept;
+
+  union {
+    word  num;   // Current value when small
+    mpz_t value; // Current value when big
+  };
+  bool big;
+};
+
+// An Integer_view is a read-only GMP integer with the value of an Integer,
+// for passing mixed operands to GMP functions. A small value is viewed
+// without allocating memory. The view must not outlive the integer.
+class Integer_view {
+public:
+  explicit Integer_view(const Integer&);
+  explicit Integer_view(Integer::word);
+
+  mpz_srcptr get() const { return ptr; }
+
 private:
-  mpz_t value; // Current integer value
+  void init(Integer::word);
+
+  mp_limb_t limbs[(sizeof(Integer::word) + sizeof(mp_limb_t) - 1)
+                  / sizeof(mp_limb_t)];
+  mpz_t view;
+  mpz_srcptr ptr;
+};
+
+// An Integer_arena supplies the limbs of GMP integers created on the
+// current thread while it is in use (see Integer_arena_scope). Freeing a
+// limb allocated from the arena does nothing; all limbs are released at
+// once when the arena is destroyed. Other limbs are managed with malloc
+// and free, even while an arena is alive.
+//
+// Only integers made while an arena is in use hold its limbs, so the
+// owner of the arena decides which integers those are. None of them may
+// outlive the arena, but they and the arena may be destroyed on any
+// thread. An arena is in use on at most one thread at a time.
+class Integer_arena {
+public:
+  Integer_arena();
+  ~Integer_arena();
+
+  Integer_arena(const Integer_arena&) = delete;
+  Integer_arena& operator=(const Integer_arena&) = delete;
+
+  // Returns n bytes for limbs, or nullptr when no more can be reserved.
+  void* allocate(std::size_t n);
+
+  // Returns the number of bytes reserved for limbs.
+  std::size_t capacity() const { return reserved; }
+
+private:
+  using Span = std::pair<char*, std::size_t>;
+
+  std::vector<Span> spans; // The memory reserved, released on destruction
+  char* cur;               // The free part of the last span
+  char* last;
+  std::size_t reserved;
+};
+
+// An Integer_arena_scope uses an arena for the GMP integers created or
+// grown on the current thread during its lifetime. Scopes nest, and the
+// innermost one supplies the limbs. For example:
+//
+//    Integer_arena_scope scope(arena);
+//    Integer kept = n; // The limbs of kept come from the arena.
+class Integer_arena_scope {
+public:
+  explicit Integer_arena_scope(Integer_arena&);
+  ~Integer_arena_scope();
+
+  Integer_arena_scope(const Integer_arena_scope&) = delete;
+  Integer_arena_scope& operator=(const Integer_arena_scope&) = delete;
+
+private:
+  Integer_arena* prev; // The arena in use before this scope
 };
 
 // Equality
 bool operator==(const Integer& a, const Integer& b);
 
-inline bool 
+inline bool
 operator!=(const Integer& a, const Integer& b) {
   return not(a == b);
 }
 
+// Hashing
+//
+// Returns a hash of the value of n. Equal values have equal hashes,
+// however they are represented.
+std::size_t hash(const Integer& n);
+
 // Ordering
 bool operator<(const Integer& a, const Integer& b);
 
@@ -96,27 +275,53 @@ operator%(const Integer& a, const Integer& b) {
   return Integer(a) %= b;
 }
 
+// Formatting
+//
+// Writes the digits of n in the given base into the buffer ending at
+// last, and returns a pointer to the first character written. The buffer
+// must have room for at least small_digits characters.
+constexpr std::size_t small_digits = sizeof(Integer::word) * 3 + 1;
+
+char* format_small(char* last, Integer::word n, int base);
+
+// Returns the null-terminated digits of the large integer n in the given
+// base. GMP writes them into a buffer that is reused by every call on the
+// thread, so the result is valid until the next call.
+const char* format_large(const Integer& n, int base);
+
+// Appends the digits of n in the given base to the buffer. Small values
+// are formatted without allocating, and large values are written by GMP
+// directly into the buffer.
+void write(Output_buffer& buf, const Integer& n, int base = 10);
+
 // Streaming
 template<typename C, typename T>
   inline std::basic_ostream<C, T>&
   operator<<(std::basic_ostream<C, T>& os, const Integer& z) {
     int  base = stream_base(os);
-    std::size_t n = mpz_sizeinbase(z.data(), base) + 1;
-    std::unique_ptr<char[]> buf(new char[n]);
-    switch (base) {
-      case 8:
-        gmp_snprintf(buf.get(), n, "%Zo", z.data());
-        break;
-      case 10:
-        gmp_snprintf(buf.get(), n, "%Zd", z.data());
-        break;
-      case 16:
-        gmp_snprintf(buf.get(), n, "%Zx", z.data());
-        break;
+    if (z.is_small()) {
+      char buf[small_digits + 1];
+      char* last = buf + small_digits;
+      *last = 0;
+      return os << format_small(last, z.small_value(), base);
     }
-    return os << buf.get(); 
+    return os << format_large(z, base);
   }
 
 } // namespace steve
 
+
+namespace std {
+
+// Hash support for Integers.
+template<>
+struct hash<sarah::Integer> {
+  std::size_t
+  operator()(const sarah::Integer& n) const {
+    return sarah::hash(n);
+  }
+};
+
+} // namespace std
+
 #endif
@@ -1,4 +1,3 @@
-
 #include <iostream>
 
 #include "Ios.hpp"
@@ -16,4 +15,37 @@ stream_base(const std::ios_base& s) {
     return 10;
 }
 
+// -------------------------------------------------------------------------- //
+// Output buffer
+
+Output_buffer::Output_buffer(std::size_t n)
+  : first(new char[n]), cur(first.get()), last(cur + n) { }
+
+void
+Output_buffer::put(const char* s, std::size_t n) {
+  std::memcpy(reserve(n), s, n);
+  cur += n;
+}
+
+// Grow the buffer so that at least n characters are available past the
+// current position. The capacity at least doubles.
+void
+Output_buffer::grow(std::size_t n) {
+  std::size_t used = size();
+  std::size_t cap = 2 * capacity();
+  if (cap < used + n)
+    cap = used + n;
+  std::unique_ptr<char[]> p(new char[cap]);
+  std::memcpy(p.get(), first.get(), used);
+  first = std::move(p);
+  cur = first.get() + used;
+  last = first.get() + cap;
+}
+
+void
+Output_buffer::flush(std::ostream& os) {
+  os.write(data(), size());
+  clear();
+}
+
 } // namespace sarah
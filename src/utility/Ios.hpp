@@ -1,8 +1,11 @@
-
 #ifndef SARAH_IOS_HPP
 #define SARAH_IOS_HPP
 
+#include <cstddef>
+#include <cstring>
 #include <iosfwd>
+#include <memory>
+#include <string>
 
 namespace sarah {
 
@@ -14,6 +17,56 @@ namespace sarah {
 // entire ios facility to make this work.
 int stream_base(const std::ios_base& s);
 
+// An Output_buffer accumulates text in a single contiguous, growable
+// block of memory. Writing to the buffer does not go through the stream
+// machinery, and its memory is kept when it is cleared, so a buffer can
+// be reused across many large outputs without reallocating.
+//
+// Formatters that know an upper bound on the length of their output can
+// write in place: reserve(n) returns a pointer to at least n writable
+// characters, and advance(p) marks the characters before p as written.
+class Output_buffer {
+public:
+  explicit Output_buffer(std::size_t n = 256);
+
+  Output_buffer(const Output_buffer&) = delete;
+  Output_buffer& operator=(const Output_buffer&) = delete;
+
+  // Appending
+  void put(char c) { *reserve(1) = c; ++cur; }
+  void put(const char* s, std::size_t n);
+  void put(const char* s) { put(s, std::strlen(s)); }
+  void put(const std::string& s) { put(s.data(), s.size()); }
+
+  // In-place writing
+  char* reserve(std::size_t n) {
+    if (std::size_t(last - cur) < n)
+      grow(n);
+    return cur;
+  }
+  void advance(char* p) { cur = p; }
+
+  // Observers
+  const char* data() const { return first.get(); }
+  std::size_t size() const { return cur - first.get(); }
+  std::size_t capacity() const { return last - first.get(); }
+  bool empty() const { return size() == 0; }
+  std::string str() const { return std::string(data(), size()); }
+
+  // Discards the contents of the buffer, retaining its memory.
+  void clear() { cur = first.get(); }
+
+  // Writes the contents of the buffer to os and clears it.
+  void flush(std::ostream& os);
+
+private:
+  void grow(std::size_t);
+
+  std::unique_ptr<char[]> first;
+  char* cur;
+  char* last;
+};
+
 } // namespace sarah
 
-#endif
\ No newline at end of file
+#endif
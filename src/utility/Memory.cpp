@@ -1,2 +1,61 @@
 
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
 #include "Memory.hpp"
+
+namespace sarah {
+
+// -------------------------------------------------------------------------- //
+// Arena
+
+Arena::Arena(std::size_t n)
+  : head(nullptr), tail(nullptr), next(n), reserved(0) { }
+
+Arena::~Arena() {
+  for (Chunk& c : chunks)
+    std::free(c.first);
+}
+
+// Allocate a new chunk that can hold at least n bytes.
+void
+Arena::grow(std::size_t n) {
+  while (next < n)
+    next *= 2;
+  char* p = static_cast<char*>(std::malloc(next));
+  if (not p)
+    throw std::bad_alloc();
+  chunks.push_back({p, p + next});
+  head = p;
+  tail = p + next;
+  reserved += next;
+  next *= 2;
+}
+
+// Allocate n bytes aligned to align, which must be a power of 2.
+void*
+Arena::allocate(std::size_t n, std::size_t align) {
+  std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(head) + align - 1)
+                   & ~(std::uintptr_t)(align - 1);
+  if (not head or p + n > reinterpret_cast<std::uintptr_t>(tail)) {
+    grow(n + align);
+    p = (reinterpret_cast<std::uintptr_t>(head) + align - 1)
+      & ~(std::uintptr_t)(align - 1);
+  }
+  head = reinterpret_cast<char*>(p + n);
+  return reinterpret_cast<void*>(p);
+}
+
+// The most recently allocated chunks are searched first since they are
+// the most likely to hold recently allocated objects.
+bool
+Arena::owns(const void* p) const {
+  const char* q = static_cast<const char*>(p);
+  for (auto i = chunks.rbegin(); i != chunks.rend(); ++i)
+    if (i->first <= q and q < i->last)
+      return true;
+  return false;
+}
+
+} // namespace sarah
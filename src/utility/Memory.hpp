@@ -2,25 +2,171 @@
 #ifndef SARAH_MEMORY_HPP
 #define SARAH_MEMORY_HPP
 
+#include <cstddef>
 #include <memory>
-#include <list>
-#include <set>
+#include <new>
+#include <vector>
+#include <utility>
 
 namespace sarah {
 
+/// An arena allocates memory by bumping a pointer through large chunks.
+/// Individual allocations are never freed; all memory is released at
+/// once when the arena is destroyed. Chunks double in size, so the number
+/// of chunks is logarithmic in the number of bytes allocated.
+class Arena {
+public:
+  explicit Arena(std::size_t n = 4096);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(std::size_t n,
+                 std::size_t align = alignof(std::max_align_t));
+
+  // Returns true when p points into memory allocated by the arena.
+  bool owns(const void* p) const;
+
+  // Returns the number of bytes reserved by the arena.
+  std::size_t capacity() const { return reserved; }
+
+private:
+  struct Chunk {
+    char* first;
+    char* last;
+  };
+
+  void grow(std::size_t);
+
+  std::vector<Chunk> chunks;
+  char* head;
+  char* tail;
+  std::size_t next;     // Size of the next chunk
+  std::size_t reserved; // Total bytes in all chunks
+};
+
+
+/// A factory mark records the objects made by a Basic_factory, so that
+/// later objects can be released.
+struct Factory_mark {
+  std::size_t slabs; // The number of slabs in use
+  std::size_t used;  // The number of objects in the last slab in use
+  std::size_t count; // The number of objects made
+};
 
 /// A basic factory is responsible for the allocation and management of
 /// objects of the specified type.
+///
+/// Objects are constructed contiguously in slabs whose sizes double, up
+/// to a limit, so making an object is usually a pointer bump. Objects are
+/// not released individually. Instead, every object made after a mark can
+/// be destroyed at once by releasing the mark, and the rest are destroyed,
+/// in the reverse order of their creation, with the factory. Released
+/// slabs are kept and reused by later objects.
 template<typename T>
-  struct Basic_factory : std::list<T>
+  class Basic_factory
   {
+  public:
+    Basic_factory()
+      : cur(0), head(nullptr), tail(nullptr), count(0) { }
+
+    ~Basic_factory();
+
+    Basic_factory(const Basic_factory&) = delete;
+    Basic_factory& operator=(const Basic_factory&) = delete;
+
     template<typename... Args>
       T& make(Args&&... args) {
-        this->emplace_back(std::forward<Args>(args)...);
-        return this->back();
+        if (head == tail)
+          next_slab();
+        T* p = new (head) T(std::forward<Args>(args)...);
+        ++head;
+        ++count;
+        return *p;
       }
+
+    // Returns the number of objects made by the factory.
+    std::size_t size() const { return count; }
+
+    // Returns the number of bytes reserved by the slabs.
+    std::size_t capacity() const {
+      std::size_t n = 0;
+      for (const Slab& s : slabs)
+        n += (s.last - s.first) * sizeof(T);
+      return n;
+    }
+
+    // Returns a mark for the objects made so far.
+    Factory_mark mark() const {
+      return {cur, cur ? std::size_t(head - slabs[cur - 1].first) : 0, count};
+    }
+
+    // Destroys every object made since m was taken. Marks taken after m
+    // are invalidated.
+    void release(const Factory_mark& m);
+
+  private:
+    static constexpr std::size_t first_slab = 64;
+    static constexpr std::size_t max_slab = 4096;
+
+    struct Slab {
+      T* first;
+      T* last;
+    };
+
+    void next_slab();
+
+    std::vector<Slab> slabs;
+    std::size_t cur;   // The number of slabs in use
+    T* head;           // The next object in the current slab
+    T* tail;           // The end of the current slab
+    std::size_t count; // The number of objects made
   };
 
+// Move to the next slab, allocating it if needed. All slabs in use are
+// full.
+template<typename T>
+  void
+  Basic_factory<T>::next_slab() {
+    if (cur == slabs.size()) {
+      std::size_t n = first_slab;
+      if (not slabs.empty())
+        n = 2 * (slabs.back().last - slabs.back().first);
+      if (n > max_slab)
+        n = max_slab;
+      T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+      slabs.push_back({p, p + n});
+    }
+    head = slabs[cur].first;
+    tail = slabs[cur].last;
+    ++cur;
+  }
+
+template<typename T>
+  void
+  Basic_factory<T>::release(const Factory_mark& m) {
+    while (cur > m.slabs) {
+      T* first = slabs[cur - 1].first;
+      while (head != first)
+        (--head)->~T();
+      --cur;
+      head = cur ? slabs[cur - 1].last : nullptr;
+    }
+    T* last = cur ? slabs[cur - 1].first + m.used : nullptr;
+    while (head != last)
+      (--head)->~T();
+    tail = cur ? slabs[cur - 1].last : nullptr;
+    count = m.count;
+  }
+
+template<typename T>
+  Basic_factory<T>::~Basic_factory() {
+    release({0, 0, 0});
+    for (Slab& s : slabs)
+      ::operator delete(s.first);
+  }
+
 /// A singleton factory contains a single object of the specified type.
 /// It is allocated on the first request and every subsequent request
 /// returns the same value.
@@ -1,18 +1,211 @@
 
-#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
 
 #include "String.hpp"
-
-// The string table.
-using String_table = std::unordered_set<std::string>;
-static String_table strings;
+#include "Memory.hpp"
 
 namespace sarah {
 
-// Returns a pointer to a unique string with the same spelling as str.
-const std::string* 
-String::intern(const std::string& str) {
-  return &*strings.insert(str).first;
+namespace {
+
+using Rep = String::Rep;
+
+// FNV-1a hash of the characters in s.
+inline std::size_t
+hash_chars(const char* s, std::size_t n) {
+  std::size_t h = 14695981039346656037ull;
+  for (std::size_t i = 0; i < n; ++i) {
+    h ^= static_cast<unsigned char>(s[i]);
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+inline const char*
+chars(const Rep* r) { return reinterpret_cast<const char*>(r + 1); }
+
+// -------------------------------------------------------------------------- //
+// Symbol table
+//
+// The symbol table maps symbol ids to strings. It is a sequence of
+// segments whose sizes double, so that entries never move and can be
+// read without locking. Segment k holds the ids in [B(2^k - 1),
+// B(2^(k+1) - 1)), where B is the size of the first segment.
+
+struct Symbol_table {
+  static constexpr std::size_t base = 1024;
+  static constexpr int segments = 32;
+
+  Symbol_table()
+    : count(0), ready(0) {
+    for (auto& s : segs)
+      s.store(nullptr, std::memory_order_relaxed);
+  }
+
+  ~Symbol_table() {
+    for (auto& s : segs)
+      delete[] s.load(std::memory_order_relaxed);
+  }
+
+  std::atomic<const Rep*>& slot(std::uint32_t);
+  std::atomic<const Rep*>* segment(int);
+  std::uint32_t published();
+
+  std::atomic<std::atomic<const Rep*>*> segs[segments];
+  std::atomic<std::uint32_t> count; // The next symbol id
+  std::atomic<std::uint32_t> ready; // Ids below this are published
+  std::mutex lock;                  // Guards segment allocation
+};
+
+// Returns the entry for symbol id n, allocating its segment if needed.
+std::atomic<const Rep*>&
+Symbol_table::slot(std::uint32_t n) {
+  std::size_t q = n / base + 1;
+  int k = 0;
+  while (q >>= 1)
+    ++k;
+  std::size_t first = base * ((std::size_t(1) << k) - 1);
+  return segment(k)[n - first];
+}
+
+std::atomic<const Rep*>*
+Symbol_table::segment(int k) {
+  if (std::atomic<const Rep*>* s = segs[k].load(std::memory_order_acquire))
+    return s;
+  std::lock_guard<std::mutex> g(lock);
+  std::atomic<const Rep*>* s = segs[k].load(std::memory_order_relaxed);
+  if (not s) {
+    std::size_t n = base << k;
+    s = new std::atomic<const Rep*>[n];
+    for (std::size_t i = 0; i < n; ++i)
+      s[i].store(nullptr, std::memory_order_relaxed);
+    segs[k].store(s, std::memory_order_release);
+  }
+  return s;
+}
+
+// Returns the number of ids below which every slot is published. Ids are
+// taken before their strings are published, and shards publish them out
+// of order, so the count of ids taken may include empty slots.
+std::uint32_t
+Symbol_table::published() {
+  std::uint32_t n = ready.load(std::memory_order_acquire);
+  std::uint32_t last = count.load(std::memory_order_acquire);
+  while (n < last and slot(n).load(std::memory_order_acquire))
+    ++n;
+  std::uint32_t r = ready.load(std::memory_order_relaxed);
+  while (r < n and not ready.compare_exchange_weak(r, n))
+    ;
+  return n;
+}
+
+// -------------------------------------------------------------------------- //
+// String table
+//
+// The string table is divided into shards, selected by the high bits of
+// a string's hash, so that threads interning different strings rarely
+// contend. Each shard is an open addressing hash table probed linearly,
+// guarded by its own lock. Its size is a power of two and it is kept at
+// most half full. The strings themselves are allocated in the shard's
+// arena, and are never released.
+
+struct String_shard {
+  String_shard()
+    : slots(64, nullptr), count(0) { }
+
+  const Rep* intern(Symbol_table&, const char*, std::size_t, std::size_t);
+  void rehash();
+
+  std::mutex lock;
+  Arena text;
+  std::vector<const Rep*> slots;
+  std::size_t count;
+};
+
+// Returns the interned string with the same spelling as s, creating it
+// if needed. The hash of s is h.
+const Rep*
+String_shard::intern(Symbol_table& syms, const char* s, std::size_t n,
+                     std::size_t h) {
+  std::lock_guard<std::mutex> g(lock);
+  std::size_t mask = slots.size() - 1;
+  std::size_t i = h & mask;
+  while (const Rep* r = slots[i]) {
+    if (r->hash == h and r->size == n and std::memcmp(chars(r), s, n) == 0)
+      return r;
+    i = (i + 1) & mask;
+  }
+
+  std::uint32_t id = syms.count.fetch_add(1, std::memory_order_relaxed);
+  void* p = text.allocate(sizeof(Rep) + n + 1, alignof(Rep));
+  Rep* r = new (p) Rep {h, n, id};
+  char* c = reinterpret_cast<char*>(r + 1);
+  std::memcpy(c, s, n);
+  c[n] = 0;
+  syms.slot(id).store(r, std::memory_order_release);
+  slots[i] = r;
+  if (2 * ++count > slots.size())
+    rehash();
+  return r;
+}
+
+// Double the number of slots. Entries are reinserted using their
+// cached hashes.
+void
+String_shard::rehash() {
+  std::vector<const Rep*> old(2 * slots.size(), nullptr);
+  old.swap(slots);
+  std::size_t mask = slots.size() - 1;
+  for (const Rep* r : old) {
+    if (not r)
+      continue;
+    std::size_t i = r->hash & mask;
+    while (slots[i])
+      i = (i + 1) & mask;
+    slots[i] = r;
+  }
+}
+
+struct String_table {
+  static constexpr int shards = 16;
+
+  const Rep* intern(const char* s, std::size_t n) {
+    std::size_t h = hash_chars(s, n);
+    return shard[h >> (sizeof(h) * 8 - 4)].intern(symbols, s, n, h);
+  }
+
+  Symbol_table symbols;
+  String_shard shard[shards];
+};
+
+// The string table is created on first use so that strings may be
+// interned during static initialization.
+String_table&
+strings() {
+  static String_table t;
+  return t;
+}
+
+} // namespace
+
+// Returns a pointer to a unique string with the same spelling as the
+// n characters in str.
+const String::Rep*
+String::intern(const char* str, std::size_t n) {
+  return strings().intern(str, n);
+}
+
+String
+String::from_id(std::uint32_t n) {
+  return String(strings().symbols.slot(n).load(std::memory_order_acquire));
+}
+
+std::size_t
+String::symbols() {
+  return strings().symbols.published();
 }
 
 } // namespace sarah
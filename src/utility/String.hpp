@@ -2,6 +2,8 @@
 #ifndef SARAH_STRING_H
 #define SARAH_STRING_H
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <iosfwd>
 
@@ -14,26 +16,39 @@ namespace sarah {
 // that each unique occurrence of a string in the text of a program appears
 // only once in the memory of the program.
 //
+// The characters of interned strings are stored contiguously in an arena,
+// together with their length and hash. Strings are interned directly from
+// a sequence of characters, without constructing a temporary std::string.
+//
+// Each interned string is also assigned a dense symbol id: ids are given
+// out in the order strings are first interned, starting at 0, and never
+// change. They can index flat arrays and bitsets of symbols, and the
+// string with a given id is found with String::from_id.
+//
+// Strings may be interned concurrently on any number of threads. Equal
+// spellings always produce the same String, whichever thread interns
+// them, so the order in which ids are assigned depends on scheduling.
+//
 // The String class is a regular, but reference semantic type.
 class String {
 public:
-  using iterator       = std::string::const_iterator;
-  using const_iterator = std::string::const_iterator;
+  using iterator       = const char*;
+  using const_iterator = const char*;
 
   String() 
-    : str_(nullptr) 
+    : rep_(nullptr) 
   { }
   
   String(const std::string& s) 
-    : str_(intern(s)) 
+    : String(s.data(), s.size()) 
   { }
 
   String(const char* s)
-    : String(std::string(s))
+    : String(s, std::strlen(s))
   { }
 
   String(const char* s, std::size_t n)
-    : String(std::string(s, n))
+    : rep_(intern(s, n))
   { }
 
   String(const char* f, const char* l)
@@ -41,27 +56,54 @@ public:
   { }
 
 
-  // Returns the underlying string pointer.
-  const std::string* ptr() const { return str_; }
+  // Returns the address of the interned string.
+  const void* ptr() const { return rep_; }
+
+  // Returns a copy of the string.
+  std::string str() const { return std::string(data(), size()); }
+
+  /// Returns a pointer to the underlying character data. The data
+  /// is null terminated.
+  const char* data() const { return reinterpret_cast<const char*>(rep_ + 1); }
 
-  // Returns a reference to the underlying string.
-  const std::string& str() const { return *str_; }
+  // Returns the number of characters in the string.
+  std::size_t size() const { return rep_->size; }
 
-  /// Returns a pointer to the underlying character data.
-  const char* data() const { return str().c_str(); }
+  // Returns the hash of the string's characters.
+  std::size_t hash() const { return rep_->hash; }
+
+  // Returns the symbol id of the string.
+  std::uint32_t id() const { return rep_->id; }
+
+  // Returns the string with the given symbol id. Behavior is undefined
+  // if no such string has been interned.
+  static String from_id(std::uint32_t);
+
+  // Returns the number of symbol ids whose strings have been published,
+  // so that from_id is valid for every id below it. Strings still being
+  // interned on other threads may have greater ids.
+  static std::size_t symbols();
 
   // Iterators
-  iterator       begin()       { return str_->begin(); }
-  const_iterator begin() const { return str_->begin(); }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size(); }
 
-  iterator       end()       { return str_->end(); }
-  const_iterator end() const { return str_->end(); }
+  // The header of an interned string. The characters follow it.
+  struct Rep {
+    std::size_t hash;
+    std::size_t size;
+    std::uint32_t id;
+  };
 
 private:
-  static const std::string* intern(const std::string&);
+  explicit String(const Rep* r)
+    : rep_(r)
+  { }
+
+  static const Rep* intern(const char*, std::size_t);
 
 private:
-  const std::string* str_;
+  const Rep* rep_;
 };
 
 // Returns true when two strings refer to the same object.
@@ -71,37 +113,37 @@ operator==(String a, String b) { return a.ptr() == b.ptr(); }
 inline bool
 operator!=(String a, String b) { return a.ptr() != b.ptr(); }
 
-// Returns true when a points to an object with a lesser address
-// than b. This operation does not define a lexicographical order.
+// Returns true when a was interned before b. This operation does not
+// define a lexicographical order.
 inline bool
-operator<(String a, String b) { return a.ptr() < b.ptr(); }
+operator<(String a, String b) { return a.id() < b.id(); }
 
 inline bool
-operator>(String a, String b) { return a.ptr() > b.ptr(); }
+operator>(String a, String b) { return a.id() > b.id(); }
 
 inline bool
-operator<=(String a, String b) { return a.ptr() <= b.ptr(); }
+operator<=(String a, String b) { return a.id() <= b.id(); }
 
 inline bool
-operator>=(String a, String b) { return a.ptr() >= b.ptr(); }
+operator>=(String a, String b) { return a.id() >= b.id(); }
 
 // Streaming
 template<typename C, typename T>
   inline std::basic_ostream<C, T>&
-  operator<<(std::basic_ostream<C, T>& os, String s) { return os << s.str(); }
+  operator<<(std::basic_ostream<C, T>& os, String s) { return os << s.data(); }
 
 } // namespace sarah
 
 
 namespace std {
 
-// Hash support for Strings.
+// Hash support for Strings. Symbol ids are distinct, so they are their
+// own hash.
 template<>
 struct hash<sarah::String> {
   std::size_t 
   operator()(sarah::String str) const {
-    hash<const void*> h;
-    return h(str.ptr());
+    return str.id();
   }
 };
 
@@ -3,6 +3,7 @@
 #define SARAH_STRUCTURE_HPP
 
 #include <tuple>
+#include <utility>
 
 namespace sarah {
 
@@ -12,6 +13,9 @@ template<typename T>
     Atom(const T& x)
       : data(x) { }
 
+    Atom(T&& x)
+      : data(std::move(x)) { }
+
     const T& first() const { return data; }
 
     T data;
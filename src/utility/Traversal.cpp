@@ -0,0 +1 @@
+#include "Traversal.hpp"
@@ -0,0 +1,102 @@
+#ifndef SARAH_TRAVERSAL_HPP
+#define SARAH_TRAVERSAL_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace sarah {
+
+// -------------------------------------------------------------------------- //
+// Traversal
+//
+// The traverse() algorithm walks a tree depth-first, keeping its place on
+// a stack in the heap rather than on the call stack, so the depth of the
+// tree is bounded only by memory. The walk is described by a walker. A
+// walker derives from Walker<N, R>, where N is a handle to a node and R
+// is the result computed for each node, and defines:
+//
+//    void enter(const N& n, std::vector<N>& ns)
+//      Called before the operands of n are visited. Appends the nodes to
+//      visit under n to ns, in order.
+//
+//    bool next(const N& n, std::size_t i, const R* rs)
+//      Called before the ith node under n is visited, with the results
+//      of the nodes before it. When this returns false, the remaining
+//      nodes under n are skipped, and their results are R().
+//
+//    R leave(const N& n, R* rs, std::size_t k)
+//      Called after the k nodes under n are visited, with their results.
+//      Returns the result of n.
+//
+// The nodes under n need not be its operands. A walker may visit an
+// operand more than once, or skip it, or visit nodes that are not part
+// of the tree at all.
+
+// The result of a walk that computes nothing.
+struct No_result { };
+
+template<typename N, typename R = No_result>
+  struct Walker {
+    using Node = N;
+    using Result = R;
+
+    // By default, every node is visited.
+    bool next(const Node&, std::size_t, const Result*) { return true; }
+  };
+
+// Walks the tree rooted at n, returning the result of n.
+template<typename W>
+  typename W::Result
+  traverse(W& w, const typename W::Node& n) {
+    using Node = typename W::Node;
+    using Result = typename W::Result;
+
+    // A node whose operands are being visited. The nodes under it are
+    // nodes[first, first + size), and the results of those visited so
+    // far start at results[base].
+    struct Frame {
+      Node node;
+      std::size_t first;
+      std::size_t size;
+      std::size_t next;
+      std::size_t base;
+    };
+
+    std::vector<Frame> path;
+    std::vector<Node> nodes;
+    std::vector<Result> results;
+
+    auto enter = [&](const Node& x) {
+      std::size_t first = nodes.size();
+      w.enter(x, nodes);
+      path.push_back({x, first, nodes.size() - first, 0, results.size()});
+    };
+
+    enter(n);
+    while (true) {
+      Frame& f = path.back();
+      if (f.next < f.size) {
+        std::size_t i = f.next++;
+        if (w.next(f.node, i, results.data() + f.base)) {
+          Node x = nodes[f.first + i];
+          enter(x);
+          continue;
+        }
+        results.resize(f.base + f.size);
+        f.next = f.size;
+      }
+
+      Result r = w.leave(f.node, results.data() + f.base, f.size);
+      results.resize(f.base);
+      nodes.resize(f.first);
+      path.pop_back();
+      if (path.empty())
+        return r;
+      results.push_back(std::move(r));
+    }
+  }
+
+} // namespace sarah
+
+#endif
@@ -9,25 +9,57 @@ namespace sarah {
 
 // -------------------------------------------------------------------------- //
 // Facilities
+//
+// A class T may define a static member function classof that takes a
+// reference to one of its bases and returns true when the object is a T.
+// The conversions and queries below use it when it is available, and
+// fall back to dynamic_cast and typeid otherwise.
+
+template<typename T, typename U>
+  inline auto
+  cast_to(U* u, int) -> decltype(T::classof(*u), static_cast<T*>(u)) {
+    return T::classof(*u) ? static_cast<T*>(u) : nullptr;
+  }
+
+template<typename T, typename U>
+  inline T*
+  cast_to(U* u, long) { return dynamic_cast<T*>(u); }
+
+template<typename T>
+  inline auto
+  kind_of(const T* t, int) -> decltype(t->tag) { return t->tag; }
+
+template<typename T>
+  inline std::type_index
+  kind_of(const T* t, long) { return typeid(*t); }
+
 
 /// Attempts to dynamically convert u to T.
 template<typename T, typename U>
   inline T* 
-  as(U* u) { return dynamic_cast<T*>(u); }
+  as(U* u) { return u ? cast_to<T>(u, 0) : nullptr; }
 
 template<typename T, typename U>
   inline const T* 
-  as(const U* u) { return dynamic_cast<const T*>(u); }
+  as(const U* u) { return u ? cast_to<const T>(u, 0) : nullptr; }
 
 /// Attempts to dynamically convert u to T. Note that this overload will
 /// throw an exception if the conversion is not possible.
 template<typename T, typename U>
   inline T& 
-  as(U& u) { return dynamic_cast<T&>(u); }
+  as(U& u) {
+    if (T* t = as<T>(&u))
+      return *t;
+    throw std::bad_cast();
+  }
 
 template<typename T, typename U>
   inline const T& 
-  as(const U& u) { return dynamic_cast<const T&>(u); }
+  as(const U& u) {
+    if (const T* t = as<T>(&u))
+      return *t;
+    throw std::bad_cast();
+  }
 
 
 /// Returns true only if u can be dynamically converted to T.
@@ -41,14 +73,15 @@ template<typename T, typename U>
   is(const U& t) { return is<T>(&t); }
 
 
-/// Returns type information for the type of t.
+/// Returns the kind of t. This is the kind tag of classes that have
+/// one, and the dynamic type of t otherwise.
 template<typename T>
-  inline std::type_index
-  kind(const T* t) { return typeid(*t); }
+  inline auto
+  kind(const T* t) -> decltype(kind_of(t, 0)) { return kind_of(t, 0); }
 
 template<typename T>
-  inline std::type_index
-  kind(const T& t) { return kind(&t); }
+  inline auto
+  kind(const T& t) -> decltype(kind_of(&t, 0)) { return kind_of(&t, 0); }
 
 
 } // namespace sarah
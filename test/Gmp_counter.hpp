@@ -0,0 +1,82 @@
+#ifndef SARAH_GMP_COUNTER_HPP
+#define SARAH_GMP_COUNTER_HPP
+
+#include <cassert>
+#include <cstddef>
+
+#include <gmp.h>
+
+namespace sarah {
+
+// A Gmp_counter counts calls to GMP's memory functions while it is
+// alive. It forwards each call to the functions that were installed when
+// it was created, and reinstalls them when it is destroyed, unless they
+// have been replaced in the meantime. Only one counter may be alive.
+class Gmp_counter {
+public:
+  Gmp_counter() {
+    State& s = state();
+    assert(not s.active);
+    mp_get_memory_functions(&s.allocate, &s.reallocate, &s.free);
+    mp_set_memory_functions(allocate, reallocate, free);
+    s.active = true;
+    reset();
+  }
+
+  ~Gmp_counter() {
+    State& s = state();
+    void* (*a)(std::size_t);
+    mp_get_memory_functions(&a, nullptr, nullptr);
+    if (a == allocate)
+      mp_set_memory_functions(s.allocate, s.reallocate, s.free);
+    s.active = false;
+  }
+
+  Gmp_counter(const Gmp_counter&) = delete;
+  Gmp_counter& operator=(const Gmp_counter&) = delete;
+
+  // Returns the number of calls since the last reset.
+  std::size_t calls() const { return state().calls; }
+
+  // Returns the number of calls that allocated or grew limbs since the
+  // last reset.
+  std::size_t allocations() const { return state().allocs; }
+
+  void reset() { state().calls = state().allocs = 0; }
+
+private:
+  struct State {
+    bool active;
+    std::size_t calls;
+    std::size_t allocs;
+    void* (*allocate)(std::size_t);
+    void* (*reallocate)(void*, std::size_t, std::size_t);
+    void (*free)(void*, std::size_t);
+  };
+
+  static State& state() {
+    static State s;
+    return s;
+  }
+
+  static void* allocate(std::size_t n) {
+    ++state().calls;
+    ++state().allocs;
+    return state().allocate(n);
+  }
+
+  static void* reallocate(void* p, std::size_t old, std::size_t n) {
+    ++state().calls;
+    ++state().allocs;
+    return state().reallocate(p, old, n);
+  }
+
+  static void free(void* p, std::size_t n) {
+    ++state().calls;
+    state().free(p, n);
+  }
+};
+
+} // namespace sarah
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SARAH_PROGRAM_HPP
+#define SARAH_PROGRAM_HPP
+
+#include <string>
+#include <utility>
+
+#include "syntax/Lexer.hpp"
+#include "syntax/Parser.hpp"
+
+namespace sarah {
+
+// Returns the tokens of the text, moved out of the lexer. The parser
+// looks at the token after the last, so an end token is added.
+inline Token_list
+tokenize(std::string& s) {
+  Lexer lex(s);
+  lex();
+  Token_list toks = std::move(lex.tokens);
+  toks.emplace_back();
+  return toks;
+}
+
+// A Program holds a text with its tokens and parse tree. The tree is
+// null when the text is ill-formed. Tests and benchmarks keep a program
+// alive while its tree is in use.
+struct Program {
+  explicit Program(std::string s)
+    : text(std::move(s)), toks(tokenize(text)), parse(toks), tree(parse())
+  { }
+
+  Program(const Program&) = delete;
+  Program& operator=(const Program&) = delete;
+
+  std::string text;
+  Token_list toks;
+  Parser parse;
+  const Tree* tree;
+};
+
+} // namespace sarah
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SARAH_TEST_HPP
+#define SARAH_TEST_HPP
+
+#include <iostream>
+
+namespace sarah {
+
+// Returns the number of failed checks.
+inline int&
+failures() {
+  static int n = 0;
+  return n;
+}
+
+// Report a failed check.
+inline void
+expect(bool ok, const char* what, const char* file, int line) {
+  if (not ok) {
+    std::cerr << file << ':' << line << ": check failed: " << what << '\n';
+    ++failures();
+  }
+}
+
+} // namespace sarah
+
+// Check that the condition holds, reporting it if it does not. A test
+// program returns the result of report() from main.
+#define expect(cond) sarah::expect((cond), #cond, __FILE__, __LINE__)
+
+namespace sarah {
+
+inline int
+report() { return failures() == 0 ? 0 : 1; }
+
+} // namespace sarah
+
+#endif
@@ -0,0 +1,197 @@
+// Tests that arithmetic on small integers does not call the GMP
+// allocator, that an integer literal reaches its expression with at most
+// one allocation, and that printing integers does not allocate. GMP's
+// memory functions and operator new are replaced with ones that count
+// calls.
+
+#include <climits>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "utility/Integer.hpp"
+#include "utility/Gcd.hpp"
+#include "utility/Ios.hpp"
+#include "semantics/Elaborator.hpp"
+
+#include "Test.hpp"
+#include "Program.hpp"
+#include "Gmp_counter.hpp"
+
+using namespace sarah;
+
+namespace {
+
+Gmp_counter gmp;      // Counts calls to GMP's memory functions
+std::size_t news = 0; // Counts calls to operator new
+
+// A stream buffer that discards its output without allocating.
+struct Sink : std::streambuf {
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    return n;
+  }
+};
+
+// Small values stay inline through arithmetic, comparison, gcd, parsing
+// and formatting.
+void
+test_small() {
+  if (not Integer_policy::words)
+    return;
+  Output_buffer buf;
+  std::ostringstream ss;
+  std::string digits = "123456789";
+  gmp.reset();
+  for (long i = 1; i < 1000; ++i) {
+    Integer a(i * 7919);
+    Integer b(-i);
+    Integer c = a * b + a - b;
+    c /= Integer(3);
+    c %= Integer(1000003);
+    Integer d = gcd(a, Integer(i * 13));
+    Integer e = lcm(d, Integer(12));
+    Integer f = Integer::from_digits(digits.data(),
+                                     digits.data() + digits.size());
+    Integer g(std::move(f));
+    g = c;
+    expect(not (a < b) and a != b and d <= a and e > Integer(0));
+    write(buf, g);
+    ss << c;
+  }
+  expect(gmp.calls() == 0);
+}
+
+// Values that overflow a word use GMP, so the counter sees calls. This
+// shows that it is installed.
+void
+test_large() {
+  if (Integer_policy::checked)
+    return;
+  gmp.reset();
+  {
+    Integer a(LONG_MAX);
+    a += Integer(1);
+    expect(not a.is_small());
+  }
+  expect(gmp.calls() != 0);
+}
+
+// Returns the sum of n copies of the literal, compared with 0.
+std::string
+sum(const std::string& lit, int n) {
+  std::string s = lit;
+  for (int i = 1; i < n; ++i)
+    s += " + " + lit + std::to_string(i);
+  return s + " == 0";
+}
+
+// Makes the nodes of the integer literals among the tokens.
+void
+make_literals(Context& cxt, const Token_list& toks) {
+  for (const Token& tok : toks)
+    if (tok.type == Int_literal_tok)
+      cxt.make_int(take_value(tok));
+}
+
+// Checks that lexing and elaborating literals spelled like lit makes at
+// most limit GMP allocations for each.
+void
+check_literals(const std::string& lit, bool consing, std::size_t limit) {
+  const int n = 100;
+  std::string text = sum(lit, n);
+  Elaborator elab(false, consing);
+  gmp.reset();
+  Program p(text);
+  const Tree* t = p.tree;
+  expect(t != nullptr);
+  if (not t)
+    return;
+  Elaboration e = elab(*t);
+  expect(bool(e));
+  expect(gmp.allocations() <= limit * n);
+
+  // The values were taken from the tokens, so elaborating the tree again
+  // converts their spellings.
+  Elaboration e2 = elab(*t);
+  expect(e2 and same(e.expr(), e2.expr()));
+
+  // Moving values from tokens into nodes allocates nothing once the
+  // factory has slabs for them. The nodes made by the first set of
+  // tokens are released so that the second set reuses their slabs. A
+  // hash table grows as it is filled, so only the plain factory is
+  // checked.
+  if (consing)
+    return;
+  Context cxt;
+  {
+    Factory_scope scope(cxt);
+    make_literals(cxt, p.toks);
+  }
+  Token_list again = tokenize(text);
+  gmp.reset();
+  news = 0;
+  make_literals(cxt, again);
+  expect(gmp.allocations() == 0);
+  expect(news == 0);
+}
+
+// A small literal is not allocated at all, and a large one is allocated
+// once by the lexer and moved from the token into its node.
+void
+test_literals() {
+  if (Integer_policy::words) {
+    check_literals("12345", false, 0);
+    check_literals("12345", true, 0);
+  }
+  if (not Integer_policy::checked) {
+    check_literals("123456789012345678901234567890", false, 1);
+    check_literals("123456789012345678901234567890", true, 1);
+  }
+}
+
+// Printing large values to a stream reuses a buffer, so once it has held
+// the longest value nothing is allocated.
+void
+test_print() {
+  if (Integer_policy::checked)
+    return;
+  Sink sink;
+  std::ostream os(&sink);
+  Integer big(String("123456789012345678901234567890123456789"));
+  Integer small(42);
+  os << std::oct << big << std::dec;
+  gmp.reset();
+  news = 0;
+  for (int i = 0; i < 100; ++i) {
+    os << big << std::hex << big << std::oct << big << std::dec;
+    os << small;
+  }
+  expect(gmp.calls() == 0);
+  expect(news == 0);
+}
+
+} // namespace
+
+// Count every allocation made with operator new.
+void*
+operator new(std::size_t n) {
+  ++news;
+  if (void* p = std::malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void
+operator delete(void* p) noexcept { std::free(p); }
+
+int
+main() {
+  test_small();
+  test_large();
+  test_literals();
+  test_print();
+  return report();
+}
@@ -0,0 +1,54 @@
+// Tests that very deep expressions are parsed and elaborated without
+// exhausting the stack. Nested parentheses still recurse in the parser,
+// so they are not covered here.
+
+#include <string>
+
+#include "semantics/Elaborator.hpp"
+
+#include "Test.hpp"
+#include "Program.hpp"
+
+using namespace sarah;
+
+namespace {
+
+constexpr int depth = 1000000;
+
+// Returns the text repeated n times, followed by the last text.
+std::string
+chain(const std::string& s, const std::string& last) {
+  std::string r;
+  r.reserve(s.size() * depth + last.size());
+  for (int i = 0; i < depth; ++i)
+    r += s;
+  return r + last;
+}
+
+// Parse and elaborate the text twice, and check that both elaborations
+// are the same expression.
+void
+test_chain(std::string s) {
+  Program p(std::move(s));
+  expect(p.tree != nullptr);
+  if (not p.tree)
+    return;
+
+  Elaborator elab;
+  Elaboration e1 = elab(*p.tree);
+  Elaboration e2 = elab(*p.tree);
+  expect(bool(e1) and bool(e2));
+  if (e1 and e2)
+    expect(same(e1.expr(), e2.expr()));
+}
+
+} // namespace
+
+int
+main() {
+  test_chain(chain("not ", "1 == 0"));
+  test_chain(chain("1 == 0 and ", "1 == 0"));
+  test_chain(chain("1 == 0 -> ", "1 == 0"));
+  test_chain(chain("forall x:int. ", "x > 0"));
+  return report();
+}
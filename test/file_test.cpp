@@ -0,0 +1,82 @@
+// Tests that files read by path and through streams have the same text.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "utility/File.hpp"
+
+#include "Test.hpp"
+
+using namespace sarah;
+
+namespace {
+
+// A temporary file with the given text, removed when it is destroyed.
+struct Temp_file {
+  explicit Temp_file(const std::string& text)
+    : path("sarah_file_test.tmp") {
+    std::ofstream os(path, std::ios::binary);
+    os << text;
+  }
+
+  ~Temp_file() { std::remove(path.c_str()); }
+
+  std::string path;
+};
+
+inline std::string
+text(const File& f) { return std::string(f.begin(), f.end()); }
+
+// A regular file is mapped, and has the same bytes when it is read
+// through a stream. The text spans several blocks of the stream reader
+// and ends with a partial block.
+void
+test_same_bytes() {
+  std::string s;
+  for (int i = 0; s.size() < 200000; ++i)
+    s += "forall x" + std::to_string(i) + ":int. x > 0 and\n\t";
+  s += '\0';
+  s += "\xff end";
+  Temp_file tmp(s);
+
+  File mapped(tmp.path);
+  expect(mapped.mapped());
+  expect(text(mapped) == s);
+
+  std::ifstream is(tmp.path, std::ios::binary);
+  File streamed(is);
+  expect(not streamed.mapped());
+  expect(text(streamed) == s);
+}
+
+// Empty, missing and non-regular files have no text, and are not mapped.
+void
+test_no_text() {
+  Temp_file tmp("");
+  File empty(tmp.path);
+  expect(empty.size() == 0 and not empty.mapped());
+
+  File missing("sarah_file_test.missing");
+  expect(missing.size() == 0 and not missing.mapped());
+
+  File dir(".");
+  expect(dir.size() == 0 and not dir.mapped());
+
+  File null("/dev/null");
+  expect(null.size() == 0 and not null.mapped());
+
+  std::istringstream is;
+  File stream(is);
+  expect(stream.size() == 0 and stream.begin() == stream.end());
+}
+
+} // namespace
+
+int
+main() {
+  test_same_bytes();
+  test_no_text();
+  return report();
+}
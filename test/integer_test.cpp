@@ -0,0 +1,159 @@
+// Tests the representation of integers and integer literals under the
+// configured backend.
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "utility/Integer.hpp"
+#include "syntax/Lexer.hpp"
+
+#include "Test.hpp"
+
+using namespace sarah;
+
+namespace {
+
+// The width of a checked backend, or 0 when values are unbounded.
+#if SARAH_INTEGER_BACKEND == SARAH_INTEGER_INT64
+constexpr int width = 64;
+#elif SARAH_INTEGER_BACKEND == SARAH_INTEGER_INT128
+constexpr int width = 128;
+#else
+constexpr int width = 0;
+#endif
+
+// Lex the text, which must contain a single token.
+Token
+lex(std::string s) {
+  Lexer lex(s);
+  const Token_list& toks = lex();
+  expect(toks.size() == 1);
+  return toks.front();
+}
+
+// A moved-from integer is zero, in the representation of the policy,
+// and can be used again.
+void
+test_move() {
+  Integer a(5);
+  Integer b(std::move(a));
+  expect(b == Integer(5));
+  expect(a == Integer(0));
+  expect(a.is_small() == Integer_policy::words);
+  a += Integer(7);
+  expect(a == Integer(7));
+
+  Integer c(3);
+  c = std::move(b);
+  expect(c == Integer(5));
+  expect(b == Integer(0));
+  expect(b.is_small() == Integer_policy::words);
+  b = c;
+  expect(b == Integer(5));
+}
+
+// Reading a small value, even alongside a large one, leaves it inline.
+void
+test_read() {
+  if (not Integer_policy::words)
+    return;
+  const Integer a(12345);
+  Integer_view v(a);
+  expect(mpz_cmp_si(v.get(), 12345) == 0);
+  expect(hash(a) == hash(Integer(12345)));
+  if (not Integer_policy::checked) {
+    const Integer big(String("1000000000000000000000000000000"));
+    expect(a < big);
+    expect(a + big > big);
+  }
+  expect(a.is_small());
+}
+
+// Literals that do not fit the backend are diagnosed, not thrown.
+void
+test_literals() {
+  Token t1 = lex("9223372036854775807");
+  expect(t1.type == Int_literal_tok);
+  expect(t1.value == Integer(9223372036854775807L));
+
+  // 10^20 - 1 does not fit in 64 bits.
+  Token t2 = lex("99999999999999999999");
+  if (width == 64) {
+    expect(t2.type == Error_tok);
+  } else {
+    expect(t2.type == Int_literal_tok);
+    Integer n(99999999999L);
+    n *= Integer(1000000000L);
+    n += Integer(999999999L);
+    expect(t2.value == n);
+  }
+
+  // 10^40 - 1 does not fit in 128 bits.
+  Token t3 = lex("9999999999999999999999999999999999999999");
+  if (width != 0)
+    expect(t3.type == Error_tok);
+  else
+    expect(t3.type == Int_literal_tok);
+}
+
+// Only integers made while an arena is in use take limbs from it.
+void
+test_arena() {
+  if (Integer_policy::checked)
+    return;
+  Integer big(String("1000000000000000000000000000000"));
+  Integer outside;
+  {
+    Integer_arena arena;
+    outside = big * big;
+    expect(arena.capacity() == 0);
+    {
+      Integer_arena_scope scope(arena);
+      Integer inside = big * big;
+      expect(arena.capacity() != 0);
+    }
+    std::size_t n = arena.capacity();
+    outside *= big;
+    expect(arena.capacity() == n);
+  }
+  // The arena is gone, and the limbs of outside are still valid.
+  outside /= big;
+  expect(outside == big * big);
+}
+
+// An arena and the integers holding its limbs may be destroyed on a
+// thread other than the one that made them.
+void
+test_arena_thread() {
+  if (Integer_policy::checked)
+    return;
+  Integer big(String("1000000000000000000000000000000"));
+  std::unique_ptr<Integer_arena> arena;
+  std::unique_ptr<Integer> inside;
+  std::thread t([&] {
+    arena.reset(new Integer_arena());
+    Integer_arena_scope scope(*arena);
+    inside.reset(new Integer(big * big));
+  });
+  t.join();
+  expect(arena->capacity() != 0);
+  Integer outside = *inside;
+  *inside *= big;
+  expect(*inside == outside * big);
+  inside.reset();
+  arena.reset();
+  expect(outside == big * big);
+}
+
+} // namespace
+
+int
+main() {
+  test_move();
+  test_read();
+  test_literals();
+  test_arena();
+  test_arena_thread();
+  return report();
+}
@@ -0,0 +1,183 @@
+// Tests the identity of hash-consed expressions.
+
+#include <sstream>
+#include <string>
+
+#include "semantics/Elaborator.hpp"
+#include "semantics/Debug.hpp"
+
+#include "Test.hpp"
+#include "Program.hpp"
+
+using namespace sarah;
+
+namespace {
+
+// Returns the elaboration of the program, or an invalid one when it is
+// ill-formed.
+Elaboration
+elaborate(Elaborator& elab, const Program& p) {
+  if (not p.tree)
+    return {};
+  return elab(*p.tree);
+}
+
+// Bindings are consed by name, but their names are not compared.
+void
+test_bind() {
+  Context cxt(false, true);
+  const Bind& x = cxt.make_bind(cxt.make_id("x"), cxt.int_type);
+  const Bind& y = cxt.make_bind(cxt.make_id("y"), cxt.int_type);
+  const Bind& z = cxt.make_bind(cxt.make_id("x"), cxt.bool_type);
+  expect(&x != &y);
+  expect(same(x, y));
+  expect(not same(x, z));
+}
+
+// Quantifiers that differ only in the names of their bound variables are
+// the same node.
+void
+test_quantifiers() {
+  Elaborator elab(false, true);
+  Program p1("forall x:int. x > 0");
+  Program p2("forall y:int. y > 0");
+  Program p3("exists x:int. forall y:int. x > y");
+  Program p4("exists y:int. forall x:int. y > x");
+  Program p5("exists x:int. forall y:int. y > x");
+  Elaboration e1 = elaborate(elab, p1);
+  Elaboration e2 = elaborate(elab, p2);
+  Elaboration e3 = elaborate(elab, p3);
+  Elaboration e4 = elaborate(elab, p4);
+  Elaboration e5 = elaborate(elab, p5);
+  expect(e1 and e2 and e3 and e4 and e5);
+  if (not (e1 and e2 and e3 and e4 and e5))
+    return;
+  expect(&e1.expr() == &e2.expr());
+  expect(same(e1.expr(), e2.expr()));
+  expect(&e3.expr() == &e4.expr());
+  expect(not same(e3.expr(), e5.expr()));
+}
+
+// Bound variables with the same index and type are one node, named
+// after the first of them. Its name is not used: the variable is printed
+// with the name of its binder.
+void
+test_bound_name() {
+  Context cxt(false, true);
+  Environment env;
+  cxt.push(env);
+  const Id& x = cxt.make_id("x");
+  const Id& y = cxt.make_id("y");
+  const Var& vx = cxt.make_var(x, cxt.declare(x, cxt.int_type), 0);
+  const Var& vy = cxt.make_var(y, cxt.declare(y, cxt.int_type), 0);
+  cxt.pop();
+  expect(&vx == &vy);
+  expect(&vy.type() == &cxt.int_type);
+
+  const Bind& b = cxt.make_bind(y, cxt.int_type);
+  const Expr& e = cxt.make_forall(b, cxt.make_gt(vy, cxt.make_int(0)));
+  std::ostringstream os;
+  os << e;
+  expect(os.str().find('y') != std::string::npos);
+  expect(os.str().find('x') == std::string::npos);
+}
+
+// Operands whose hashes collide are still put in a canonical order, so
+// the order in which they are given does not matter.
+void
+test_collision() {
+  for (bool consing : {false, true}) {
+    Expr::Factory f(false, consing, 0);
+    const Expr& x = f.make_gt(f.make_id("x"), f.make_int(0));
+    const Expr& y = f.make_gt(f.make_id("y"), f.make_int(0));
+    const Expr& z = f.make_lt(f.make_id("x"), f.make_int(1));
+    expect(hash(x) == hash(y) and hash(x) == hash(z));
+    const Expr& a = f.make_and({&x, &y, &z});
+    const Expr& b = f.make_and({&z, &y, &x, &y});
+    expect(same(a, b));
+    expect(order(a, b) == 0);
+    expect(as<Nary>(a).operands() == as<Nary>(b).operands());
+    if (consing)
+      expect(&a == &b);
+    expect(not same(f.make_and(x, y), f.make_or(y, x)));
+  }
+}
+
+// Declarations made in a scope are released with it, so elaborating a
+// formula that fails does not leave declarations behind.
+void
+test_scope() {
+  Context cxt;
+  std::size_t n = cxt.decls.size();
+  {
+    Factory_scope scope(cxt);
+    Environment env;
+    cxt.push(env);
+    cxt.declare(cxt.make_id("x"), cxt.int_type);
+    expect(cxt.decls.size() == n + 1);
+    cxt.pop();
+  }
+  expect(cxt.decls.size() == n);
+
+  Elaborator elab;
+  n = elab.decls.size();
+  for (int i = 0; i < 100; ++i) {
+    Program p("forall x:int. exists y:int. x");
+    expect(not elaborate(elab, p));
+  }
+  expect(elab.decls.size() == n);
+
+  // Formulas elaborated and discarded in a scope leave their slabs to the
+  // next, so the factory does not grow with the number of formulas.
+  Program q("forall x:int. exists y:int. 2 * x + y < 7 and x >= y");
+  const Expr::Factory& f = elab;
+  std::size_t bytes = 0;
+  for (int i = 0; i < 100; ++i) {
+    Factory_scope scope(elab);
+    expect(bool(elaborate(elab, q)));
+    if (i == 0)
+      bytes = f.capacity();
+  }
+  expect(f.capacity() == bytes);
+  expect(elab.decls.size() == n);
+}
+
+// A snapshot holds the innermost declaration of each visible name, and
+// is not affected by later changes to the stack.
+void
+test_snapshot() {
+  Context cxt;
+  std::size_t n = cxt.snapshot().size();
+  Environment e1;
+  cxt.push(e1);
+  const Decl& x1 = cxt.declare(cxt.make_id("x"), cxt.int_type);
+  const Decl& y = cxt.declare(cxt.make_id("y"), cxt.int_type);
+  Environment e2;
+  cxt.push(e2);
+  const Decl& x2 = cxt.declare(cxt.make_id("x"), cxt.bool_type);
+  Persistent_environment inner = cxt.snapshot();
+  cxt.pop();
+  Persistent_environment outer = cxt.snapshot();
+  cxt.pop();
+
+  expect(inner.size() == n + 2);
+  expect(inner.lookup("x") == &x2);
+  expect(inner.lookup("y") == &y);
+  expect(outer.size() == n + 2);
+  expect(outer.lookup("x") == &x1);
+  expect(cxt.snapshot().size() == n);
+  expect(not cxt.snapshot().lookup("x"));
+}
+
+} // namespace
+
+int
+main() {
+  test_bind();
+  test_quantifiers();
+  test_bound_name();
+  test_collision();
+  test_scope();
+  test_snapshot();
+  return report();
+}
@@ -0,0 +1,124 @@
+// Tests the canonical linear form of arithmetic atoms.
+
+#include "semantics/Language.hpp"
+#include "semantics/Normalize.hpp"
+
+#include "Test.hpp"
+
+using namespace sarah;
+
+namespace {
+
+// A context with the integer variables x and y, declared in a scope of
+// their own.
+struct Vars : Context {
+  Vars()
+    : x((push(env), var("x"))), y(var("y")) { }
+
+  ~Vars() { pop(); }
+
+  const Var& var(const char* s) {
+    const Id& n = make_id(s);
+    return make_var(n, declare(n, int_type));
+  }
+
+  // Returns a * x + b * y + c.
+  const Expr& sum(long a, long b, long c) {
+    const Expr& ax = make_mul(make_int(a), x);
+    const Expr& by = make_mul(make_int(b), y);
+    return make_add(make_add(ax, by), make_int(c));
+  }
+
+  // Returns the linear term a * x + b * y + c.
+  const Linear& term(long a, long b, long c) {
+    return make_linear({&x, &y}, {Integer(a), Integer(b)}, Integer(c));
+  }
+
+  const Int& zero() { return make_int(0); }
+
+  Environment env;
+  const Var& x;
+  const Var& y;
+};
+
+// 2 * x + 4 * y > 3 is x + 2 * y - 2 >= 0, which is -x - 2 * y + 2 <= 0.
+void
+test_inequality() {
+  Vars v;
+  const Expr& e = normalize(v, v.make_gt(v.sum(2, 4, 0), v.make_int(3)));
+  expect(same(e, v.make_le(v.term(-1, -2, 2), v.zero())));
+
+  const Expr& f = normalize(v, v.make_ge(v.sum(2, 4, 0), v.make_int(3)));
+  expect(same(e, f));
+}
+
+// A strict inequality is tightened by 1, and the constant is rounded
+// towards the feasible side after division.
+void
+test_rounding() {
+  Vars v;
+  // 2 * x + 4 * y < 4 is x + 2 * y - 1 <= 0.
+  const Expr& lt = normalize(v, v.make_lt(v.sum(2, 4, 0), v.make_int(4)));
+  expect(same(lt, v.make_le(v.term(1, 2, -1), v.zero())));
+
+  // 2 * x + 4 * y <= 3 is x + 2 * y - 1 <= 0.
+  const Expr& le = normalize(v, v.make_le(v.sum(2, 4, 0), v.make_int(3)));
+  expect(same(le, lt));
+
+  // 2 * x + 4 * y >= -3 is -x - 2 * y - 1 <= 0.
+  const Expr& ge = normalize(v, v.make_ge(v.sum(2, 4, 0), v.make_int(-3)));
+  expect(same(ge, v.make_le(v.term(-1, -2, -1), v.zero())));
+
+  // 2 * x + 4 * y >= 3 is -x - 2 * y + 2 <= 0.
+  const Expr& up = normalize(v, v.make_ge(v.sum(2, 4, 0), v.make_int(3)));
+  expect(same(up, v.make_le(v.term(-1, -2, 2), v.zero())));
+}
+
+// An equation whose content does not divide its constant has no
+// solution, and the first coefficient of one that does is positive.
+void
+test_equation() {
+  Vars v;
+  const Expr& eq = normalize(v, v.make_eq(v.sum(2, 4, 0), v.make_int(3)));
+  expect(same(eq, v.make_bool(false)));
+
+  const Expr& ne = normalize(v, v.make_ne(v.sum(2, 4, 0), v.make_int(3)));
+  expect(same(ne, v.make_bool(true)));
+
+  const Expr& e6 = normalize(v, v.make_eq(v.sum(-2, -4, 0), v.make_int(6)));
+  expect(same(e6, v.make_eq(v.term(1, 2, 3), v.zero())));
+
+  const Expr& n6 = normalize(v, v.make_ne(v.make_int(6), v.sum(2, 4, 0)));
+  expect(same(n6, v.make_ne(v.term(1, 2, -3), v.zero())));
+}
+
+// The modulus of a divisibility constraint is divided by its common
+// factor with the term, and the constant is reduced by the result.
+void
+test_divisibility() {
+  Vars v;
+  // 6 | 4 * x + 2 * y + 2 is 3 | 2 * x + y + 1.
+  const Expr& d = normalize(v, v.make_div(v.make_int(6), v.sum(4, 2, 2)));
+  expect(same(d, v.make_div(v.make_int(3), v.term(2, 1, 1))));
+
+  // 3 | x + y + 7 is 3 | x + y + 1.
+  const Expr& r = normalize(v, v.make_div(v.make_int(3), v.sum(1, 1, 7)));
+  expect(same(r, v.make_div(v.make_int(3), v.term(1, 1, 1))));
+
+  // 4 | 2 * x + 2 * y + 1 has no solution, and 1 | x + y is always true.
+  const Expr& f = normalize(v, v.make_div(v.make_int(4), v.sum(2, 2, 1)));
+  expect(same(f, v.make_bool(false)));
+  const Expr& t = normalize(v, v.make_div(v.make_int(1), v.sum(1, 1, 0)));
+  expect(same(t, v.make_bool(true)));
+}
+
+} // namespace
+
+int
+main() {
+  test_inequality();
+  test_rounding();
+  test_equation();
+  test_divisibility();
+  return report();
+}
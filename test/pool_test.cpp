@@ -0,0 +1,78 @@
+// Tests that equality computed on an expression pool agrees with
+// equality on the expressions it was imported from.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "semantics/Elaborator.hpp"
+#include "semantics/Normalize.hpp"
+#include "semantics/Pool.hpp"
+
+#include "Test.hpp"
+#include "Program.hpp"
+
+using namespace sarah;
+
+namespace {
+
+const char* formulas[] = {
+  "forall x:int. x > 0",
+  "forall y:int. y > 0",
+  "forall x:int. x >= 0",
+  "exists x:int. forall y:int. x + 2 * y > 3",
+  "exists y:int. forall x:int. y + 2 * x > 3",
+  "exists x:int. forall y:int. y + 2 * x > 3",
+  "forall x:int. forall y:int. x < y and y < 5 or not x == 1",
+  "forall x:int. forall y:int. x < y and y < 5 or not x == 2",
+  "forall x:int. forall y:int. 2 * x - y <= 4 -> x != y",
+  "forall b:bool. b <-> true",
+  "forall c:bool. c <-> true",
+  "forall c:bool. c <-> false",
+};
+
+// Every pair of formulas, and of their normal forms, is compared in the
+// pool and as expressions. The factory does not hash-cons, so equal
+// formulas are distinct objects.
+void
+test_same() {
+  Elaborator elab;
+  std::vector<std::unique_ptr<Program>> ps;
+  std::vector<const Expr*> es;
+  for (const char* f : formulas) {
+    ps.emplace_back(new Program(f));
+    const Tree* t = ps.back()->tree;
+    expect(t != nullptr);
+    if (not t)
+      return;
+    Elaboration e = elab(*t);
+    expect(bool(e));
+    if (not e)
+      return;
+    es.push_back(&e.expr());
+    es.push_back(&normalize(elab, e.expr()));
+  }
+
+  Expr_pool pool;
+  std::vector<Expr_id> ids;
+  for (const Expr* e : es)
+    ids.push_back(pool.import(*e));
+  int equal = 0;
+  for (std::size_t i = 0; i < es.size(); ++i) {
+    for (std::size_t j = 0; j < es.size(); ++j) {
+      bool s = same(*es[i], *es[j]);
+      expect(same(pool, ids[i], ids[j]) == s);
+      equal += s and i != j;
+    }
+  }
+  // Some distinct formulas must be the same, or nothing was tested.
+  expect(equal != 0);
+}
+
+} // namespace
+
+int
+main() {
+  test_same();
+  return report();
+}
@@ -0,0 +1,85 @@
+// Tests interning strings concurrently.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utility/String.hpp"
+
+#include "Test.hpp"
+
+using namespace sarah;
+
+namespace {
+
+constexpr int threads = 8;
+constexpr int names = 20000;
+
+// Each thread interns the same names, starting at a different one, and
+// records the string it got for each.
+void
+intern(int t, std::vector<String>& out) {
+  out.resize(names);
+  for (int i = 0; i < names; ++i) {
+    int k = (i + t * names / threads) % names;
+    out[k] = String("name" + std::to_string(k));
+  }
+}
+
+// While strings are being interned, every id below the number of
+// symbols must name a string.
+void
+watch(const std::atomic<bool>& done, std::atomic<int>& missing) {
+  while (not done.load()) {
+    std::size_t n = String::symbols();
+    for (std::size_t i = n > 64 ? n - 64 : 0; i < n; ++i)
+      if (not String::from_id(i).ptr())
+        ++missing;
+  }
+}
+
+void
+test_intern() {
+  std::size_t first = String::symbols();
+  std::vector<std::vector<String>> got(threads);
+  std::atomic<bool> done(false);
+  std::atomic<int> missing(0);
+
+  std::thread watcher(watch, std::cref(done), std::ref(missing));
+  std::vector<std::thread> ts;
+  for (int t = 0; t < threads; ++t)
+    ts.emplace_back(intern, t, std::ref(got[t]));
+  for (std::thread& t : ts)
+    t.join();
+  done = true;
+  watcher.join();
+  expect(missing == 0);
+
+  // Every thread got the same string for each name.
+  for (int t = 1; t < threads; ++t)
+    expect(got[t] == got[0]);
+
+  // Distinct names have distinct ids, and every id maps back to its
+  // string.
+  std::vector<bool> seen(String::symbols(), false);
+  for (int i = 0; i < names; ++i) {
+    String s = got[0][i];
+    expect(s.str() == "name" + std::to_string(i));
+    expect(s.id() >= first and s.id() < seen.size());
+    if (s.id() >= seen.size())
+      continue;
+    expect(not seen[s.id()]);
+    seen[s.id()] = true;
+    expect(String::from_id(s.id()) == s);
+  }
+  expect(String::symbols() == first + names);
+}
+
+} // namespace
+
+int
+main() {
+  test_intern();
+  return report();
+}